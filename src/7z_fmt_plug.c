@@ -31,6 +31,7 @@ john_register_one(&fmt_sevenzip);
 #include "options.h"
 #include "sha2.h"
 #include "crc32.h"
+#include "aes_crc32.h"
 #include "unicode.h"
 #include "memdbg.h"
 
@@ -323,22 +324,8 @@ static int salt_compare(const void *x, const void *y)
 	return memcmp(s1->iv, s2->iv, 16);
 }
 
-// XXX port Python code to C *OR* use code from LZMA SDK
-static int validFolder(unsigned char *data)
-{
-	// int numcoders = self._read64Bit(file)
-	return 0;
-}
-
 static int sevenzip_decrypt(unsigned char *derived_key)
 {
-#ifdef _MSC_VER
-	unsigned char *out;
-#else
-	unsigned char out[cur_salt->length];
-#endif
-	AES_KEY akey;
-	unsigned char iv[16];
 	union {
 		unsigned char crcc[4];
 		unsigned int crci;
@@ -346,70 +333,57 @@ static int sevenzip_decrypt(unsigned char *derived_key)
 	unsigned char *crc_out = _crc_out.crcc;
 	unsigned int ccrc;
 	CRC32_t crc;
-	int i;
-	int nbytes, margin;
-
-#ifdef _MSC_VER
-	out = mem_alloc(cur_salt->length);
-#endif
-	memcpy(iv, cur_salt->iv, 16);
-
-	if(AES_set_decrypt_key(derived_key, 256, &akey) < 0) {
-		fprintf(stderr, "AES_set_decrypt_key failed in crypt!\n");
-	}
-	AES_cbc_encrypt(cur_salt->data, out, cur_salt->length, &akey, iv, AES_DECRYPT);
+	int margin;
 
 	/* various verifications tests */
 
 	// test 0, padding check, bad hack :-(
-	margin = nbytes = cur_salt->length - cur_salt->unpacksize;
-	i = cur_salt->length - 1;
-	while (nbytes > 0) {
-		if (out[i] != 0) {
-#ifdef _MSC_VER
-			MEM_FREE(out);
-#endif
-			return -1;
+	// Only the last block or two are decrypted for this, CBC lets us
+	// start anywhere given the previous ciphertext block as IV.
+	margin = cur_salt->length - cur_salt->unpacksize;
+	if (margin < 0)
+		return -1;
+	if (margin) {
+		AES_KEY akey;
+		unsigned char iv[16], out[48];
+		int first = MAX(cur_salt->unpacksize, cur_salt->length - 32) & ~15;
+		int i;
+
+		if (first)
+			memcpy(iv, cur_salt->data + first - 16, 16);
+		else
+			memcpy(iv, cur_salt->iv, 16);
+		if(AES_set_decrypt_key(derived_key, 256, &akey) < 0) {
+			fprintf(stderr, "AES_set_decrypt_key failed in crypt!\n");
 		}
-		nbytes--;
-		i--;
+		AES_cbc_encrypt(cur_salt->data + first, out,
+		                cur_salt->length - first, &akey, iv, AES_DECRYPT);
+		for (i = MAX(cur_salt->unpacksize - first, 0);
+		     i < cur_salt->length - first; i++)
+			if (out[i] != 0)
+				return -1;
 	}
 	if (margin > 7) {
 		// printf("valid padding test ;-)\n");
-		// print_hex(out, cur_salt->length);
-#ifdef _MSC_VER
-			MEM_FREE(out);
-#endif
 		return 0;
 	}
 
 	// test 1, CRC test
+	// Decryption and CRC are done in one pass, the plaintext is not kept.
 	CRC32_Init(&crc);
-	CRC32_Update(&crc, out, cur_salt->unpacksize);
+	AES_cbc_decrypt_crc32(derived_key, 256, cur_salt->data,
+	                      cur_salt->unpacksize, cur_salt->iv, &crc);
 	CRC32_Final(crc_out, crc);
 	ccrc =  _crc_out.crci; // computed CRC
 #if !ARCH_LITTLE_ENDIAN
 	ccrc = JOHNSWAP(ccrc);
 #endif
-	if (ccrc == cur_salt->crc) {
-#ifdef _MSC_VER
-		MEM_FREE(out);
-#endif
+	if (ccrc == cur_salt->crc)
 		return 0;  // XXX don't be too eager!
-	}
 
 	// XXX test 2, "well-formed folder" test
-	if (validFolder(out)) {
-		printf("validFolder check ;-)\n");
-#ifdef _MSC_VER
-		MEM_FREE(out);
-#endif
-		return 0;
-	}
+	// (validFolder() would need the plaintext, it is not implemented)
 
-#ifdef _MSC_VER
-	MEM_FREE(out);
-#endif
 	return -1;
 }
 
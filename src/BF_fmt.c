@@ -58,6 +58,12 @@ static void init(struct fmt_main *self)
 	if (n > BF_N)
 		n = BF_N;
 	fmt_BF.params.min_keys_per_crypt = n;
+#if BF_SIMD > 1
+/* The engine is picked later, leave room for the SIMD one to fill its lanes */
+	n = BF_Nmax * omp_get_max_threads();
+	if (n > BF_N)
+		n = BF_N;
+#endif
 	max = n * BF_cpt;
 	while (max > BF_N)
 		max -= n;
@@ -33,6 +33,10 @@
 #include "arch.h"
 #include "common.h"
 #include "BF_std.h"
+#if BF_SIMD > 1
+#include <omp.h>
+#include "pseudo_intrinsics.h"
+#endif
 #include "memdbg.h"
 
 BF_binary BF_out[BF_N];
@@ -381,7 +385,11 @@ void BF_std_set_key(char *key, int index, int sign_extension_bug) {
 	}
 }
 
+#if BF_SIMD > 1
+static void BF_scalar_crypt(BF_salt *salt, int n)
+#else
 void BF_std_crypt(BF_salt *salt, int n)
+#endif
 {
 #if BF_mt > 1
 	int t;
@@ -547,6 +555,223 @@ void BF_std_crypt(BF_salt *salt, int n)
 	}
 }
 
+#if BF_SIMD > 1
+/*
+ * BF_SIMD Blowfish instances side by side, one per 32-bit vector lane.  The
+ * S-boxes are interleaved by lane, so the 4 lookups of a round are 4 gathers
+ * (index = byte * BF_SIMD + lane), while the P-array and S-box writes of the
+ * key setup are plain vector stores.
+ */
+#if BF_SIMD == 16
+#define BF_SIMD_SHIFT			4
+#else
+#define BF_SIMD_SHIFT			3
+#endif
+
+struct BF_vctx {
+	BF_word S[4][0x100][BF_SIMD];
+	BF_word P[BF_ROUNDS + 2][BF_SIMD];
+};
+
+#define BF_VINDEX(x) \
+	vor(vand(x, mask), lanes)
+
+#define BF_VROUND(ctx, L, R, N) \
+	t1 = vgather_epi32(ctx.S[3], \
+	    BF_VINDEX(vslli_epi32(L, BF_SIMD_SHIFT)), 4); \
+	t2 = vgather_epi32(ctx.S[2], \
+	    BF_VINDEX(vsrli_epi32(L, 8 - BF_SIMD_SHIFT)), 4); \
+	t3 = vgather_epi32(ctx.S[1], \
+	    BF_VINDEX(vsrli_epi32(L, 16 - BF_SIMD_SHIFT)), 4); \
+	t4 = vgather_epi32(ctx.S[0], \
+	    BF_VINDEX(vsrli_epi32(L, 24 - BF_SIMD_SHIFT)), 4); \
+	t3 = vadd_epi32(t3, t4); \
+	t3 = vxor(t3, t2); \
+	R = vxor(R, vload(ctx.P[N + 1])); \
+	t3 = vadd_epi32(t3, t1); \
+	R = vxor(R, t3);
+
+#define BF_VENCRYPT(ctx, L, R) \
+	L = vxor(L, vload(ctx.P[0])); \
+	BF_VROUND(ctx, L, R, 0); \
+	BF_VROUND(ctx, R, L, 1); \
+	BF_VROUND(ctx, L, R, 2); \
+	BF_VROUND(ctx, R, L, 3); \
+	BF_VROUND(ctx, L, R, 4); \
+	BF_VROUND(ctx, R, L, 5); \
+	BF_VROUND(ctx, L, R, 6); \
+	BF_VROUND(ctx, R, L, 7); \
+	BF_VROUND(ctx, L, R, 8); \
+	BF_VROUND(ctx, R, L, 9); \
+	BF_VROUND(ctx, L, R, 10); \
+	BF_VROUND(ctx, R, L, 11); \
+	BF_VROUND(ctx, L, R, 12); \
+	BF_VROUND(ctx, R, L, 13); \
+	BF_VROUND(ctx, L, R, 14); \
+	BF_VROUND(ctx, R, L, 15); \
+	t4 = R; \
+	R = L; \
+	L = vxor(t4, vload(ctx.P[BF_ROUNDS + 1]));
+
+#define BF_vbody() \
+	L = R = vsetzero(); \
+	ptr = ctx.P[0]; \
+	do { \
+		BF_VENCRYPT(ctx, L, R); \
+		vstore(ptr, L); \
+		vstore(ptr + BF_SIMD, R); \
+		ptr += 2 * BF_SIMD; \
+	} while (ptr < ctx.P[0] + (BF_ROUNDS + 2) * BF_SIMD); \
+\
+	ptr = ctx.S[0][0]; \
+	do { \
+		ptr += 2 * BF_SIMD; \
+		BF_VENCRYPT(ctx, L, R); \
+		vstore(ptr - 2 * BF_SIMD, L); \
+		vstore(ptr - BF_SIMD, R); \
+	} while (ptr < ctx.S[3][0xFF]);
+
+static void BF_simd_crypt(BF_salt *salt, int n)
+{
+	int t;
+
+#pragma omp parallel for default(none) private(t) shared(n, BF_init_state, BF_init_key, BF_exp_key, salt, BF_magic_w, BF_out)
+	for (t = 0; t < n; t += BF_SIMD) {
+		struct BF_vctx CC_CACHE_ALIGN ctx;
+		BF_word CC_CACHE_ALIGN key[BF_ROUNDS + 2][BF_SIMD];
+		BF_word CC_CACHE_ALIGN out[6][BF_SIMD];
+		vtype L, R, t1, t2, t3, t4;
+		vtype lanes, mask;
+		BF_word *ptr;
+		BF_word count;
+		int i, j;
+
+		for (j = 0; j < BF_SIMD; j++)
+			out[0][j] = j;
+		lanes = vload(out[0]);
+		mask = vset1_epi32(0xFF << BF_SIMD_SHIFT);
+
+		for (i = 0; i < BF_ROUNDS + 2; i++)
+		for (j = 0; j < BF_SIMD; j++) {
+			ctx.P[i][j] = BF_init_key[t + j][i];
+			key[i][j] = BF_exp_key[t + j][i];
+		}
+		for (i = 0; i < 4; i++)
+		for (j = 0; j < 0x100; j++)
+			vstore(ctx.S[i][j], vset1_epi32(BF_init_state.S[i][j]));
+
+		L = R = vsetzero();
+		for (i = 0; i < BF_ROUNDS + 2; i += 2) {
+			L = vxor(L, vset1_epi32(salt->salt[i & 2]));
+			R = vxor(R, vset1_epi32(salt->salt[(i & 2) + 1]));
+			BF_VENCRYPT(ctx, L, R);
+			vstore(ctx.P[i], L);
+			vstore(ctx.P[i + 1], R);
+		}
+
+		ptr = ctx.S[0][0];
+		do {
+			ptr += 4 * BF_SIMD;
+			L = vxor(L, vset1_epi32(salt->salt[(BF_ROUNDS + 2) & 3]));
+			R = vxor(R, vset1_epi32(salt->salt[(BF_ROUNDS + 3) & 3]));
+			BF_VENCRYPT(ctx, L, R);
+			vstore(ptr - 4 * BF_SIMD, L);
+			vstore(ptr - 3 * BF_SIMD, R);
+
+			L = vxor(L, vset1_epi32(salt->salt[(BF_ROUNDS + 4) & 3]));
+			R = vxor(R, vset1_epi32(salt->salt[(BF_ROUNDS + 5) & 3]));
+			BF_VENCRYPT(ctx, L, R);
+			vstore(ptr - 2 * BF_SIMD, L);
+			vstore(ptr - BF_SIMD, R);
+		} while (ptr < ctx.S[3][0xFF]);
+
+		count = 1 << salt->rounds;
+		do {
+			for (i = 0; i < BF_ROUNDS + 2; i++)
+				vstore(ctx.P[i], vxor(vload(ctx.P[i]), vload(key[i])));
+
+			BF_vbody();
+
+			for (i = 0; i < BF_ROUNDS + 2; i++)
+				vstore(ctx.P[i], vxor(vload(ctx.P[i]),
+				    vset1_epi32(salt->salt[i & 3])));
+
+			BF_vbody();
+		} while (--count);
+
+		for (i = 0; i < 6; i += 2) {
+			L = vset1_epi32(BF_magic_w[i]);
+			R = vset1_epi32(BF_magic_w[i + 1]);
+
+			count = 64;
+			do {
+				BF_VENCRYPT(ctx, L, R);
+			} while (--count);
+
+			vstore(out[i], L);
+			vstore(out[i + 1], R);
+		}
+
+		for (j = 0; j < BF_SIMD; j++) {
+			for (i = 0; i < 6; i++)
+				BF_out[t + j][i] = out[i][j];
+/* This has to be bug-compatible with the original implementation :-) */
+			BF_out[t + j][5] &= ~(BF_word)0xFF;
+		}
+	}
+}
+
+/*
+ * Gather throughput varies a lot between CPU generations, so the first few
+ * calls alternate between the scalar and the SIMD code, timing both (per
+ * lane and per expensive key setup iteration), and the faster one is kept.
+ */
+#define BF_TIMED_CALLS			2
+
+static int BF_engine;		/* 0 = not decided yet, 1 = scalar, 2 = SIMD */
+static int BF_timed_calls[2];
+static double BF_timed_cost[2];
+
+void BF_std_crypt(BF_salt *salt, int n)
+{
+	double start;
+	int simd, lanes;
+
+/*
+ * Batches too small to fill the vector lanes (single mode, the tail of a
+ * wordlist) are best left to the scalar code, and would skew the timing.
+ */
+	if (n < BF_Nmax) {
+		BF_scalar_crypt(salt, n);
+		return;
+	}
+
+	if (BF_engine) {
+		if (BF_engine == 2)
+			BF_simd_crypt(salt, n);
+		else
+			BF_scalar_crypt(salt, n);
+		return;
+	}
+
+	simd = BF_timed_calls[1] < BF_timed_calls[0];
+	start = omp_get_wtime();
+	if (simd) {
+		BF_simd_crypt(salt, n);
+		lanes = (n + BF_SIMD - 1) / BF_SIMD * BF_SIMD;
+	} else {
+		BF_scalar_crypt(salt, n);
+		lanes = (n + BF_Nscalar - 1) / BF_Nscalar * BF_Nscalar;
+	}
+/* Charge for all lanes computed, so partial batches don't skew the choice */
+	BF_timed_cost[simd] += (omp_get_wtime() - start) /
+	    ((double)lanes * ((BF_word)1 << salt->rounds));
+
+	if (++BF_timed_calls[simd] == BF_TIMED_CALLS && simd)
+		BF_engine = (BF_timed_cost[1] < BF_timed_cost[0]) ? 2 : 1;
+}
+#endif
+
 #if BF_mt == 1
 void BF_std_crypt_exact(int index)
 {
@@ -21,18 +21,28 @@
 #include "BF_common.h"
 
 #if BF_X2 == 3
-#define BF_Nmin				3
+#define BF_Nscalar			3
 #elif BF_X2
-#define BF_Nmin				2
+#define BF_Nscalar			2
 #else
-#define BF_Nmin				1
+#define BF_Nscalar			1
 #endif
 
 #if defined(_OPENMP) && !BF_ASM
+#define BF_Nmin				BF_Nscalar
+#if BF_SIMD > 1
+/* Per thread room for a full batch of either the scalar or the SIMD code */
+#define BF_Nmax				(BF_Nscalar * BF_SIMD)
+#else
+#define BF_Nmax				BF_Nmin
+#endif
 #define BF_cpt				3
 #define BF_mt				256
-#define BF_N				(BF_Nmin * BF_mt)
+#define BF_N				(BF_Nmax * BF_mt)
 #else
+#undef BF_SIMD
+#define BF_SIMD				0
+#define BF_Nmin				BF_Nscalar
 #define BF_mt				1
 #define BF_N				BF_Nmin
 #endif
@@ -43,11 +53,19 @@
 extern BF_binary BF_out[BF_N];
 
 #if BF_X2 == 3
-#define BF_ALGORITHM_NAME		"Blowfish 32/" ARCH_BITS_STR " X3"
+#define BF_ALGORITHM_SCALAR		"Blowfish 32/" ARCH_BITS_STR " X3"
 #elif BF_X2
-#define BF_ALGORITHM_NAME		"Blowfish 32/" ARCH_BITS_STR " X2"
+#define BF_ALGORITHM_SCALAR		"Blowfish 32/" ARCH_BITS_STR " X2"
+#else
+#define BF_ALGORITHM_SCALAR		"Blowfish 32/" ARCH_BITS_STR
+#endif
+
+#if BF_SIMD == 16
+#define BF_ALGORITHM_NAME		BF_ALGORITHM_SCALAR " or 512/512 AVX512F gather"
+#elif BF_SIMD == 8
+#define BF_ALGORITHM_NAME		BF_ALGORITHM_SCALAR " or 256/256 AVX2 gather"
 #else
-#define BF_ALGORITHM_NAME		"Blowfish 32/" ARCH_BITS_STR
+#define BF_ALGORITHM_NAME		BF_ALGORITHM_SCALAR
 #endif
 
 /*
@@ -351,6 +351,39 @@ typedef __m512i vtype;
 #define vshr(dst, src, shift) \
 	(dst) = _mm512_srli_epi32((src), (shift))
 
+#elif defined(__AVX512F__) && DES_BS_DEPTH == 512
+#include <immintrin.h>
+
+typedef __m512i vtype;
+
+#define vst(dst, ofs, src) \
+	_mm512_store_si512((vtype *)((DES_bs_vector *)&(dst) + (ofs)), (src))
+
+#define vxorf(a, b) \
+	_mm512_xor_si512((a), (b))
+
+/*
+ * vpternlog lets us do the bitwise select used throughout sboxes-s.c (and
+ * the NOT, which otherwise costs a load of "ones") as a single instruction.
+ * The immediates are truth tables indexed by (a << 2) | (b << 1) | c of
+ * the three operands in the order passed.
+ */
+#define vnot(dst, a) \
+	(dst) = _mm512_ternarylogic_epi32((a), (a), (a), 0x55)
+#define vand(dst, a, b) \
+	(dst) = _mm512_and_si512((a), (b))
+#define vor(dst, a, b) \
+	(dst) = _mm512_or_si512((a), (b))
+#define vandn(dst, a, b) \
+	(dst) = _mm512_andnot_si512((b), (a))
+#define vsel(dst, a, b, c) \
+	(dst) = _mm512_ternarylogic_epi32((c), (b), (a), 0xCA)
+
+#define vshl(dst, src, shift) \
+	(dst) = _mm512_slli_epi64((src), (shift))
+#define vshr(dst, src, shift) \
+	(dst) = _mm512_srli_epi64((src), (shift))
+
 #elif defined(__AVX__) && DES_BS_DEPTH == 256 && !defined(DES_BS_NO_AVX256)
 #include <immintrin.h>
 
@@ -0,0 +1,26 @@
+/*
+ * This software is hereby released to the general public under the following
+ * terms:
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ */
+
+#ifndef _JOHN_AES_CRC32_H
+#define _JOHN_AES_CRC32_H
+
+#include <stddef.h>
+
+#include "aes.h"
+#include "crc32.h"
+
+/*
+ * AES-CBC decrypt 'in' with a 128 or 256 bit raw key and update the
+ * CRC-32 'value' with the first 'len' bytes of plaintext.  The plaintext
+ * itself is never returned.  Whole blocks are read, so 'in' must hold at
+ * least len rounded up to 16 bytes.
+ */
+extern void AES_cbc_decrypt_crc32(const unsigned char *key, int bits,
+                                  const unsigned char *in, size_t len,
+                                  const unsigned char *iv, CRC32_t *value);
+
+#endif
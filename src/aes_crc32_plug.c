@@ -0,0 +1,178 @@
+/*
+ * This software is hereby released to the general public under the following
+ * terms:
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted.
+ *
+ * AES-CBC decryption fused with CRC-32 of the plaintext, for archive formats
+ * that verify stored data by its checksum (RAR3 -m0, 7-Zip).  With AES-NI
+ * and PCLMULQDQ, four blocks are decrypted at a time and folded into the CRC
+ * straight from registers, so a payload is a single read-only pass over the
+ * ciphertext.  Otherwise we decrypt an L1-sized chunk at a time and CRC it
+ * while it is still hot.
+ */
+
+#include <string.h>
+
+#include "arch.h"
+#include "aes_crc32.h"
+#include "memdbg.h"
+
+#if __AES__ && CRC32_FOLD
+
+#define EXPAND128(r, rcon) do {	  \
+		__m128i k = rk[r - 1], t; \
+		t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(k, rcon), 0xff); \
+		k = _mm_xor_si128(k, _mm_slli_si128(k, 4)); \
+		k = _mm_xor_si128(k, _mm_slli_si128(k, 4)); \
+		k = _mm_xor_si128(k, _mm_slli_si128(k, 4)); \
+		rk[r] = _mm_xor_si128(k, t); \
+	} while (0)
+
+#define EXPAND256(r, rcon) do {	  \
+		__m128i k = rk[r - 2], t; \
+		t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(rk[r - 1], rcon), 0xff); \
+		k = _mm_xor_si128(k, _mm_slli_si128(k, 4)); \
+		k = _mm_xor_si128(k, _mm_slli_si128(k, 4)); \
+		k = _mm_xor_si128(k, _mm_slli_si128(k, 4)); \
+		rk[r] = _mm_xor_si128(k, t); \
+		if (r == 14) break; \
+		k = rk[r - 1]; \
+		t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(rk[r], 0), 0xaa); \
+		k = _mm_xor_si128(k, _mm_slli_si128(k, 4)); \
+		k = _mm_xor_si128(k, _mm_slli_si128(k, 4)); \
+		k = _mm_xor_si128(k, _mm_slli_si128(k, 4)); \
+		rk[r + 1] = _mm_xor_si128(k, t); \
+	} while (0)
+
+/*
+ * Expands the key into a schedule for the equivalent inverse cipher,
+ * returning the number of rounds.
+ */
+static int decrypt_schedule(__m128i *dk, const unsigned char *key, int bits)
+{
+	__m128i rk[15];
+	int i, nr;
+
+	rk[0] = _mm_loadu_si128((__m128i*)key);
+	if (bits == 256) {
+		rk[1] = _mm_loadu_si128((__m128i*)(key + 16));
+		EXPAND256(2, 0x01); EXPAND256(4, 0x02); EXPAND256(6, 0x04);
+		EXPAND256(8, 0x08); EXPAND256(10, 0x10); EXPAND256(12, 0x20);
+		EXPAND256(14, 0x40);
+		nr = 14;
+	} else {
+		EXPAND128(1, 0x01); EXPAND128(2, 0x02); EXPAND128(3, 0x04);
+		EXPAND128(4, 0x08); EXPAND128(5, 0x10); EXPAND128(6, 0x20);
+		EXPAND128(7, 0x40); EXPAND128(8, 0x80); EXPAND128(9, 0x1b);
+		EXPAND128(10, 0x36);
+		nr = 10;
+	}
+
+	dk[0] = rk[nr];
+	for (i = 1; i < nr; i++)
+		dk[i] = _mm_aesimc_si128(rk[nr - i]);
+	dk[nr] = rk[0];
+
+	return nr;
+}
+
+#undef EXPAND128
+#undef EXPAND256
+
+static inline __m128i decrypt_block(const __m128i *dk, int nr, __m128i c)
+{
+	int r;
+
+	c = _mm_xor_si128(c, dk[0]);
+	for (r = 1; r < nr; r++)
+		c = _mm_aesdec_si128(c, dk[r]);
+	return _mm_aesdeclast_si128(c, dk[nr]);
+}
+
+void AES_cbc_decrypt_crc32(const unsigned char *key, int bits,
+                           const unsigned char *in, size_t len,
+                           const unsigned char *iv, CRC32_t *value)
+{
+	__m128i dk[15], prev, c[4], b[4];
+	unsigned char tail[64];
+	size_t blocks;
+	int nr, r, j;
+
+	nr = decrypt_schedule(dk, key, bits);
+	prev = _mm_loadu_si128((__m128i*)iv);
+
+	if (len >= 64) {
+		CRC32_fold_t fold;
+		int started = 0;
+
+		do {
+			for (j = 0; j < 4; j++) {
+				c[j] = _mm_loadu_si128((__m128i*)(in + 16 * j));
+				b[j] = _mm_xor_si128(c[j], dk[0]);
+			}
+			for (r = 1; r < nr; r++)
+				for (j = 0; j < 4; j++)
+					b[j] = _mm_aesdec_si128(b[j], dk[r]);
+			for (j = 0; j < 4; j++)
+				b[j] = _mm_aesdeclast_si128(b[j], dk[nr]);
+			b[0] = _mm_xor_si128(b[0], prev);
+			b[1] = _mm_xor_si128(b[1], c[0]);
+			b[2] = _mm_xor_si128(b[2], c[1]);
+			b[3] = _mm_xor_si128(b[3], c[2]);
+			prev = c[3];
+
+			if (started)
+				CRC32_Fold64(&fold, b[0], b[1], b[2], b[3]);
+			else {
+				CRC32_FoldInit(&fold, *value, b[0], b[1], b[2], b[3]);
+				started = 1;
+			}
+			in += 64;
+			len -= 64;
+		} while (len >= 64);
+
+		*value = CRC32_FoldFinal(&fold);
+	}
+
+	blocks = (len + 15) / 16;
+	for (j = 0; j < blocks; j++) {
+		__m128i cb = _mm_loadu_si128((__m128i*)(in + 16 * j));
+
+		_mm_storeu_si128((__m128i*)&tail[16 * j],
+		                 _mm_xor_si128(decrypt_block(dk, nr, cb), prev));
+		prev = cb;
+	}
+	CRC32_Update(value, tail, len);
+}
+
+#else
+
+#define CHUNK_SIZE	4096
+
+void AES_cbc_decrypt_crc32(const unsigned char *key, int bits,
+                           const unsigned char *in, size_t len,
+                           const unsigned char *iv, CRC32_t *value)
+{
+	aes_fptr_cbc decrypt = (bits == 256) ?
+		get_AES_dec256_CBC() : get_AES_dec128_CBC();
+	unsigned char plain[CHUNK_SIZE];
+	unsigned char ivec[16];
+
+	memcpy(ivec, iv, 16);
+
+	while (len) {
+		size_t inlen = (len > CHUNK_SIZE) ? CHUNK_SIZE : len;
+		size_t blocks = (inlen + 15) / 16;
+
+		decrypt((unsigned char*)in, plain, (unsigned char*)key,
+		        blocks, ivec);
+		CRC32_Update(value, plain, inlen);
+		/* Don't rely on the implementation updating the IV */
+		memcpy(ivec, in + 16 * (blocks - 1), 16);
+		in += 16 * blocks;
+		len -= inlen;
+	}
+}
+
+#endif
@@ -35,6 +35,9 @@
 #include <sys/times.h>
 #endif
 #include <stdlib.h> /* setenv */
+#if !defined(__DJGPP__) && !defined(__BEOS__) && !defined(__MINGW32__) && !defined (_MSC_VER)
+#include <sys/resource.h>
+#endif
 
 #include "times.h"
 
@@ -55,6 +58,11 @@
 
 #ifndef BENCH_BUILD
 #include "options.h"
+#include "loader.h"
+#include "cracker.h"
+#include "status.h"
+#include "logger.h"
+#include "path.h"
 #else
 /*
  * This code was copied from loader.c.  It has been stripped to bare bones
@@ -71,6 +79,7 @@ static void _ldr_init_database(struct db_main *db) {
 	db->salt_size -= sizeof(struct db_keys *);
 	db->options = mem_calloc(sizeof(struct db_options), 1);
 	db->salts = NULL;
+	db->salt_arena = NULL;
 	db->password_hash = NULL;
 	db->password_hash_func = NULL;
 	db->salt_hash = mem_alloc(
@@ -177,6 +186,9 @@ void ldr_free_test_db(struct db_main *db)
 
 #ifndef BENCH_BUILD
 static char cost_msg[128 * FMT_TUNABLE_COSTS];
+/* Tunable costs of the two salts benchmarked, for --bench-json */
+static unsigned int cost_value[2][FMT_TUNABLE_COSTS];
+static int cost_count;
 #endif
 
 long clk_tck = 0;
@@ -408,6 +420,7 @@ char *benchmark_format(struct fmt_main *format, int salts,
 
 #ifndef BENCH_BUILD
 	*cost_msg = 0;
+	memcpy(cost_value, t_cost, sizeof(cost_value));
 	for (i = 0; i < FMT_TUNABLE_COSTS &&
 		     format->methods.tunable_cost_value[i] != NULL; i++) {
 		char msg[128];
@@ -427,6 +440,7 @@ char *benchmark_format(struct fmt_main *format, int salts,
 			strcat(cost_msg, ", ");
 		strcat(cost_msg, msg);
 	}
+	cost_count = i;
 #endif
 
 /* Smashed passwords: -1001 turns into -1 and -1000 turns into 0, and
@@ -631,6 +645,238 @@ void gather_results(struct bench_results *results)
 }
 #endif
 
+#ifndef BENCH_BUILD
+/*
+ * --bench-json and --bench-compare.  We write one line per format so that
+ * reading a previous file back doesn't need a full blown JSON parser.
+ */
+struct bench_baseline {
+	char *label, *test;
+	double cps;
+};
+
+static FILE *json_file;
+static int json_formats;
+static struct bench_baseline *baseline;
+static int baseline_count, compared, regressed;
+static double threshold;
+
+static void json_string(FILE *file, const char *s)
+{
+	putc('"', file);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fprintf(file, "\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			fprintf(file, "\\u%04x", (unsigned char)*s);
+		else
+			putc(*s, file);
+	}
+	putc('"', file);
+}
+
+/* Reads a string as written by json_string() (ASCII only), or NULL */
+static char *json_get_string(char *p)
+{
+	char buf[LINE_BUFFER_SIZE], *q = buf;
+
+	if (*p++ != '"')
+		return NULL;
+	while (*p && *p != '"' && q < &buf[sizeof(buf) - 1]) {
+		if (*p == '\\' && p[1])
+			p++;
+		*q++ = *p++;
+	}
+	*q = 0;
+	return str_alloc_copy(buf);
+}
+
+static double bench_cps_value(int64 *crypts, clock_t time)
+{
+	return ((double)crypts->hi * 4294967296.0 + crypts->lo) *
+		clk_tck / time;
+}
+
+static void bench_load_baseline(char *name)
+{
+	char line[LINE_BUFFER_SIZE * 4];
+	FILE *file;
+	int size = 0;
+
+	if (!(file = fopen(path_expand(name), "r")))
+		pexit("fopen: %s", path_expand(name));
+
+	while (fgets(line, sizeof(line), file)) {
+		char *p, *label;
+
+		if (!(p = strstr(line, "{\"label\": ")) ||
+		    !(label = json_get_string(p + 10)))
+			continue;
+
+		while ((p = strstr(p, "{\"test\": "))) {
+			char *test, *cps;
+
+			p += 9;
+			if (!(test = json_get_string(p)) ||
+			    !(cps = strstr(p, "\"real_cps\": ")))
+				break;
+			if (baseline_count == size) {
+				size = size ? 2 * size : 512;
+				baseline = realloc(baseline,
+					size * sizeof(*baseline));
+				if (!baseline)
+					pexit("realloc");
+			}
+			baseline[baseline_count].label = label;
+			baseline[baseline_count].test = test;
+			baseline[baseline_count++].cps = strtod(cps + 12, NULL);
+		}
+	}
+	if (ferror(file)) pexit("fgets");
+	fclose(file);
+
+	if ((threshold = cfg_get_int(SECTION_OPTIONS, NULL,
+	                             "BenchRegressionThreshold")) < 0)
+		threshold = 5;
+
+	if (john_main_process)
+		printf("Loaded %d baseline results from %s, flagging "
+		       "regressions over %.0f%%\n\n",
+		       baseline_count, name, threshold);
+}
+
+static void bench_compare(struct fmt_main *format, char *test, double cps)
+{
+	int i;
+
+	for (i = 0; i < baseline_count; i++) {
+		double change;
+
+		if (strcmp(baseline[i].label, format->params.label) ||
+		    strcmp(baseline[i].test, test) || baseline[i].cps <= 0)
+			continue;
+
+		compared++;
+		change = 100.0 * (cps - baseline[i].cps) / baseline[i].cps;
+		if (change < -threshold) {
+			regressed++;
+			printf("Regression: %s, %s: %.1f%% (%.0f c/s, "
+			       "was %.0f c/s)\n", format->params.label, test,
+			       change, cps, baseline[i].cps);
+		} else if (options.verbosity > VERB_DEFAULT)
+			printf("%s, %s: %+.1f%% vs. baseline\n",
+			       format->params.label, test, change);
+		return;
+	}
+}
+
+static void bench_json_result(int index, char *test,
+                              struct bench_results *results, double cps)
+{
+	fputs(index ? ", {\"test\": " : "{\"test\": ", json_file);
+	json_string(json_file, test);
+	fprintf(json_file, ", \"salts_done\": %d, \"real_cps\": %.1f, "
+	        "\"virtual_cps\": %.1f}",
+	        results->salts_done, cps,
+	        bench_cps_value(&results->crypts, results->virtual));
+}
+
+static void bench_report(struct fmt_main *format, int threads, char *result,
+                         char *msg_m, struct bench_results *results_m,
+                         char *msg_1, struct bench_results *results_1)
+{
+	double cps_m = 0, cps_1 = 0;
+	int i;
+
+	if (!john_main_process || !benchmark_time)
+		return;
+
+	if (!result) {
+		cps_m = bench_cps_value(&results_m->crypts, results_m->real);
+		if (msg_1)
+			cps_1 = bench_cps_value(&results_1->crypts,
+			                        results_1->real);
+	}
+
+	if (baseline_count && !result) {
+		bench_compare(format, msg_m, cps_m);
+		if (msg_1)
+			bench_compare(format, msg_1, cps_1);
+	}
+
+	if (!json_file)
+		return;
+
+	fputs(json_formats++ ? ",\n{\"label\": " : "{\"label\": ", json_file);
+	json_string(json_file, format->params.label);
+	fputs(", \"format_name\": ", json_file);
+	json_string(json_file, format->params.format_name);
+	fputs(", \"algorithm_name\": ", json_file);
+	json_string(json_file, format->params.algorithm_name);
+	fputs(", \"comment\": ", json_file);
+	json_string(json_file, format->params.benchmark_comment);
+	fprintf(json_file, ", \"omp_threads\": %d, \"mpi_procs\": %d, "
+	        "\"min_keys_per_crypt\": %d, \"max_keys_per_crypt\": %d, "
+	        "\"costs\": [",
+	        threads,
+#ifdef HAVE_MPI
+	        mpi_p,
+#else
+	        1,
+#endif
+	        format->params.min_keys_per_crypt,
+	        format->params.max_keys_per_crypt);
+	for (i = 0; !result && i < cost_count; i++) {
+		fputs(i ? ", {\"name\": " : "{\"name\": ", json_file);
+		json_string(json_file, format->params.tunable_cost_name[i]);
+		fprintf(json_file, ", \"values\": [%u, %u]}",
+		        cost_value[0][i], cost_value[1][i]);
+	}
+	fputs("], \"results\": [", json_file);
+	if (!result) {
+		bench_json_result(0, msg_m, results_m, cps_m);
+		if (msg_1)
+			bench_json_result(1, msg_1, results_1, cps_1);
+	}
+	fputs("], \"status\": ", json_file);
+	json_string(json_file, result ? (*result ? "FAILED" : "ABORTED") :
+	            "PASS");
+	fputs("}", json_file);
+}
+
+static void bench_json_open(void)
+{
+	if (!john_main_process || !benchmark_time)
+		return;
+
+	if (!(json_file = fopen(path_expand(options.bench_json), "w")))
+		pexit("fopen: %s", path_expand(options.bench_json));
+
+	fputs("{\"version\": ", json_file);
+	json_string(json_file, JOHN_VERSION);
+	fprintf(json_file, ", \"benchmark_time\": %d, \"omp_max_threads\": %d, "
+	        "\"formats\": [\n", benchmark_time,
+#ifdef _OPENMP
+	        omp_get_max_threads()
+#else
+	        1
+#endif
+		);
+	json_formats = 0;
+}
+
+static void bench_json_close(void)
+{
+	if (!json_file)
+		return;
+
+	fputs("\n]}\n", json_file);
+	if (fclose(json_file))
+		pexit("fclose");
+	json_file = NULL;
+}
+#endif
+
 int benchmark_all(void)
 {
 	struct fmt_main *format;
@@ -664,6 +910,10 @@ int benchmark_all(void)
 #endif
 
 #ifndef BENCH_BUILD
+	if (options.bench_compare)
+		bench_load_baseline(options.bench_compare);
+	if (options.bench_json)
+		bench_json_open();
 AGAIN:
 #endif
 	total = failed = 0;
@@ -913,6 +1163,14 @@ AGAIN:
 #endif
 
 next:
+#ifndef BENCH_BUILD
+#ifdef _OPENMP
+		bench_report(format, (format->params.flags & FMT_OMP) ? ompt : 1,
+#else
+		bench_report(format, 1,
+#endif
+		             result, msg_m, &results_m, msg_1, &results_1);
+#endif
 		fflush(stdout);
 		ldr_free_test_db(test_db);
 		fmt_done(format);
@@ -937,7 +1195,245 @@ next:
 #ifndef BENCH_BUILD
 	if (options.flags & FLG_LOOPTEST && !event_abort)
 		goto AGAIN;
+
+	bench_json_close();
+
+	if (compared && john_main_process)
+		printf("%d out of %d results compared to the baseline "
+		       "regressed by more than %.0f%%\n",
+		       regressed, compared, threshold);
+	MEM_FREE(baseline);
+	baseline_count = 0;
+	if (regressed)
+		return 1;
 #endif
 
 	return failed || event_abort;
 }
+
+#ifndef BENCH_BUILD
+/* Real time when --test-load started and finished loading its hashes */
+static clock_t load_start, load_end;
+
+static clock_t benchmark_get_time(void)
+{
+#if defined (__MINGW32__) || defined (_MSC_VER)
+	return clock();
+#else
+	struct tms buf;
+
+	return times(&buf);
+#endif
+}
+
+void benchmark_load(struct db_main *db)
+{
+	clk_tck_init();
+	load_start = benchmark_get_time();
+	ldr_load_synth(db, options.test_load);
+}
+
+void benchmark_load_done(void)
+{
+	load_end = benchmark_get_time();
+	crk_timing = 1;
+}
+
+void benchmark_load_report(struct db_main *db)
+{
+	char s_cands[32], s_crypts[32], node[16] = "";
+	clock_t time = benchmark_get_time() - status.start_time;
+	double total, crypt_share, lookup_share;
+	unsigned long long tables = 0;
+	struct db_salt *salt;
+
+	if (time <= 0)
+		time = 1;
+	benchmark_cps(&status.cands, time, s_cands);
+	benchmark_cps(&status.crypts, time, s_crypts);
+
+	total = (double)time / clk_tck;
+	if (total < crk_stats.crypt_all + crk_stats.lookup)
+		total = crk_stats.crypt_all + crk_stats.lookup;
+	crypt_share = total ? 100.0 * crk_stats.crypt_all / total : 0;
+	lookup_share = total ? 100.0 * crk_stats.lookup / total : 0;
+
+	for (salt = db->salts; salt; salt = salt->next) {
+		unsigned long long size;
+
+		if (salt->hash_size < 0)
+			continue;
+		size = password_hash_sizes[salt->hash_size];
+		tables += size / 8;
+		if ((size >> PASSWORD_HASH_SHR) > 1)
+			tables += (size >> PASSWORD_HASH_SHR) *
+				sizeof(struct db_password *);
+	}
+
+	if (options.node_count)
+		sprintf(node, "%u: ", options.node_min);
+
+	printf("%sTest load: %d hashes, %d salts, loaded in %.2fs, "
+	       "bitmaps+hash tables "LLu" KiB",
+	       node, db->password_count, db->salt_count,
+	       (double)(load_end - load_start) / clk_tck, tables >> 10);
+#if !defined(__DJGPP__) && !defined(__BEOS__) && !defined(__MINGW32__) && !defined (_MSC_VER)
+	{
+		struct rusage ru;
+
+		if (!getrusage(RUSAGE_SELF, &ru))
+#ifdef __APPLE__
+			printf(", peak RSS %ld KiB", (long)(ru.ru_maxrss >> 10));
+#else
+			printf(", peak RSS %ld KiB", (long)ru.ru_maxrss);
+#endif
+	}
+#endif
+	printf("\n%sTest load: %s c/s, %s C/s, time in crypt_all %.1f%%, "
+	       "lookups %.1f%%, other (candidate generation etc.) %.1f%%\n",
+	       node, s_cands, s_crypts, crypt_share, lookup_share,
+	       100.0 - crypt_share - lookup_share);
+
+	log_event("Test load: %d hashes, %s c/s, %s C/s, crypt_all %.1f%%, "
+	          "lookups %.1f%%", db->password_count, s_cands, s_crypts,
+	          crypt_share, lookup_share);
+}
+
+/*
+ * --test-generator: a format that accepts the candidates and does nothing
+ * with them, so the cracker runs the usual set_key()/crypt_all() batches
+ * but all the time goes to the cracking mode (and the cracker itself).
+ */
+static struct fmt_main fmt_null;
+
+static struct fmt_tests null_tests[] = {
+	{"$null$00000000", ""},
+	{NULL}
+};
+
+static int null_valid(char *ciphertext, struct fmt_main *self)
+{
+	return !strncmp(ciphertext, "$null$", 6);
+}
+
+static void null_set_key(char *key, int index)
+{
+}
+
+static char *null_get_key(int index)
+{
+	return "";
+}
+
+static int null_crypt_all(int *pcount, struct db_salt *salt)
+{
+	return 0;
+}
+
+static int null_cmp(void *binary, int index)
+{
+	return 0;
+}
+
+static int null_cmp_exact(char *source, int index)
+{
+	return 0;
+}
+
+void benchmark_generator(struct db_main *db)
+{
+	int i;
+
+	memset(&fmt_null, 0, sizeof(fmt_null));
+	fmt_null.params.label = "null";
+	fmt_null.params.format_name = "";
+	fmt_null.params.algorithm_name = "no-op";
+	fmt_null.params.benchmark_comment = "";
+	fmt_null.params.benchmark_length = -1;
+	fmt_null.params.plaintext_length = options.length;
+	fmt_null.params.binary_size = 4;
+	fmt_null.params.binary_align = 1;
+	fmt_null.params.salt_align = 1;
+	fmt_null.params.min_keys_per_crypt = 1;
+	fmt_null.params.max_keys_per_crypt =
+		options.force_maxkeys ? options.force_maxkeys : 1024;
+	fmt_null.params.flags = FMT_CASE | FMT_8_BIT;
+	if (options.report_utf8 || options.target_enc == UTF_8)
+		fmt_null.params.flags |= FMT_UTF8;
+	fmt_null.params.tests = null_tests;
+
+	fmt_null.methods.init = fmt_default_init;
+	fmt_null.methods.done = fmt_default_done;
+	fmt_null.methods.reset = fmt_default_reset;
+	fmt_null.methods.prepare = fmt_default_prepare;
+	fmt_null.methods.valid = null_valid;
+	fmt_null.methods.split = fmt_default_split;
+	fmt_null.methods.binary = fmt_default_binary;
+	fmt_null.methods.salt = fmt_default_salt;
+	fmt_null.methods.source = fmt_default_source;
+	for (i = 0; i < PASSWORD_HASH_SIZES; i++) {
+		fmt_null.methods.binary_hash[i] = fmt_default_binary_hash;
+		fmt_null.methods.get_hash[i] = fmt_default_get_hash;
+	}
+	fmt_null.methods.salt_hash = fmt_default_salt_hash;
+	fmt_null.methods.set_salt = fmt_default_set_salt;
+	fmt_null.methods.set_key = null_set_key;
+	fmt_null.methods.get_key = null_get_key;
+	fmt_null.methods.clear_keys = fmt_default_clear_keys;
+	fmt_null.methods.crypt_all = null_crypt_all;
+	fmt_null.methods.cmp_all = null_cmp;
+	fmt_null.methods.cmp_one = null_cmp;
+	fmt_null.methods.cmp_exact = null_cmp_exact;
+
+	db->format = &fmt_null;
+	clk_tck_init();
+	ldr_load_synth(db, 1);
+}
+
+void benchmark_generator_report(void)
+{
+	char mode[PATH_BUFFER_SIZE + 64] = "", s_cands[32];
+	clock_t time = benchmark_get_time() - status.start_time;
+	unsigned long long cands;
+
+	if (time <= 0)
+		time = 1;
+	benchmark_cps(&status.cands, time, s_cands);
+	cands = ((unsigned long long)status.cands.hi << 32) + status.cands.lo;
+
+	if (options.flags & FLG_BATCH_CHK)
+		strcat(mode, "+batch");
+	if (options.flags & FLG_SINGLE_CHK)
+		strcat(mode, "+single");
+	if (options.flags & FLG_WORDLIST_CHK)
+		strcat(mode, "+wordlist");
+	if (options.flags & FLG_PRINCE_CHK)
+		strcat(mode, "+prince");
+	if ((options.flags & FLG_RULES) &&
+	    (options.flags & (FLG_WORDLIST_CHK | FLG_PRINCE_CHK)))
+		snprintf(mode + strlen(mode), sizeof(mode) - strlen(mode),
+		         "+rules:%s", options.activewordlistrules ?
+		         options.activewordlistrules : "Wordlist");
+	if (options.flags & FLG_INC_CHK)
+		snprintf(mode + strlen(mode), sizeof(mode) - strlen(mode),
+		         "+incremental%s%s", options.charset ? ":" : "",
+		         options.charset ? options.charset : "");
+	if (options.flags & FLG_MKV_CHK)
+		strcat(mode, "+markov");
+	if (options.flags & FLG_REGEX_CHK)
+		strcat(mode, "+regex");
+	if (options.flags & FLG_MASK_CHK)
+		snprintf(mode + strlen(mode), sizeof(mode) - strlen(mode),
+		         "+mask%s%.64s", options.mask ? ":" : "",
+		         options.mask ? options.mask : "");
+	if (options.flags & FLG_EXTERNAL_CHK)
+		snprintf(mode + strlen(mode), sizeof(mode) - strlen(mode),
+		         "+external:%s", options.external);
+
+	printf("Generator test: %s, "LLu" candidates in %.2fs, %s c/s\n",
+	       *mode ? mode + 1 : "?", cands, (double)time / clk_tck,
+	       s_cands);
+	log_event("Generator test: %s, %s c/s", *mode ? mode + 1 : "?",
+	          s_cands);
+}
+#endif
@@ -72,4 +72,20 @@ extern void benchmark_cps(int64 *crypts, clock_t time, char *buffer);
  */
 extern int benchmark_all(void);
 
+/*
+ * --test-load support: loads the synthetic hashes instead of reading
+ * password files, marks the end of loading (after the database is fixed
+ * up), and reports on the cracking run once it's over.
+ */
+extern void benchmark_load(struct db_main *db);
+extern void benchmark_load_done(void);
+extern void benchmark_load_report(struct db_main *db);
+
+/*
+ * --test-generator support: loads one hash for a format that does nothing,
+ * and reports on the candidates produced once the run is over.
+ */
+extern void benchmark_generator(struct db_main *db);
+extern void benchmark_generator_report(void);
+
 #endif
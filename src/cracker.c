@@ -20,6 +20,9 @@
 #if (!AC_BUILT || HAVE_SYS_TIMES_H)
 #include <sys/times.h>
 #endif
+#if (!AC_BUILT || HAVE_SYS_TIME_H) && !_MSC_VER
+#include <sys/time.h>
+#endif
 #include <errno.h>
 #if (!AC_BUILT || HAVE_UNISTD_H) && !_MSC_VER
 #include <unistd.h>
@@ -46,9 +49,11 @@
 #include "loader.h"
 #include "logger.h"
 #include "status.h"
+#include "cracker.h"
 #include "recovery.h"
 #include "external.h"
 #include "options.h"
+#include "config.h"
 #include "mask_ext.h"
 #include "mask.h"
 #include "unicode.h"
@@ -94,6 +99,39 @@ static struct db_keys *crk_guesses;
 static int64 *crk_timestamps;
 static char crk_stdout_key[PLAINTEXT_BUFFER_SIZE];
 int64_t crk_pot_pos;
+/* What precedes crk_pot_pos in the pot, to notice it being rewritten */
+static char crk_pot_tail[LINE_BUFFER_SIZE];
+static int crk_pot_tail_len;
+int crk_timing;
+struct crk_stats crk_stats;
+static double crk_stats_start;
+
+static double crk_get_time(void)
+{
+#if defined(CLOCK_MONOTONIC) && !_MSC_VER
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+#elif (!AC_BUILT || HAVE_SYS_TIME_H) && !_MSC_VER
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/*
+ * set_key() is usually cheaper than reading the clock, so it's only counted.
+ * Its time ends up in that of candidate generation.
+ */
+static MAYBE_INLINE void crk_set_key(char *key, int index)
+{
+	crk_stats.keys++;
+	crk_methods.set_key(key, index);
+}
 
 static void crk_dummy_set_salt(void *salt)
 {
@@ -200,6 +238,14 @@ void crk_init(struct db_main *db, void (*fix_state)(void),
 
 	crk_guesses = guesses;
 
+	if (db->loaded && !crk_stats_start) {
+		if (cfg_get_bool(SECTION_OPTIONS, NULL, "PhaseCounters", 0))
+			crk_timing = 1;
+		crk_stats_start = crk_get_time();
+	}
+
+	status_metrics_init(db);
+
 	if (db->loaded) {
 		size = crk_params.max_keys_per_crypt * sizeof(int64);
 		memset(crk_timestamps = mem_alloc_tiny(size, sizeof(int64)),
@@ -323,8 +369,7 @@ static void crk_remove_hash(struct db_salt *salt, struct db_password *pw)
 }
 
 /* Negative index is not counted/reported (got it from pot sync) */
-static int crk_process_guess(struct db_salt *salt, struct db_password *pw,
-	int index)
+static int crk_guess(struct db_salt *salt, struct db_password *pw, int index)
 {
 	char utf8buf_key[PLAINTEXT_BUFFER_SIZE + 1];
 	char utf8login[PLAINTEXT_BUFFER_SIZE + 1];
@@ -402,7 +447,7 @@ static int crk_process_guess(struct db_salt *salt, struct db_password *pw,
 			ct = NULL;
 		else
 			ct = ldr_pot_source(
-				crk_methods.source(pw->source, pw->binary),
+				ldr_pw_source(crk_db->format, pw),
 				buffer);
 		log_guess(crk_db->options->flags & DB_LOGIN ? replogin : "?",
 		          crk_db->options->flags & DB_LOGIN ? repuid : "",
@@ -434,6 +479,23 @@ static int crk_process_guess(struct db_salt *salt, struct db_password *pw,
 	return 0;
 }
 
+static int crk_process_guess(struct db_salt *salt, struct db_password *pw,
+	int index)
+{
+	double start;
+	int done;
+
+	if (!crk_timing)
+		return crk_guess(salt, pw, index);
+
+	start = crk_get_time();
+	done = crk_guess(salt, pw, index);
+	crk_stats.guess += crk_get_time() - start;
+	crk_stats.guesses++;
+
+	return done;
+}
+
 static char *crk_loaded_counts(void)
 {
 	static char s_loaded_counts[80];
@@ -477,8 +539,7 @@ static int crk_remove_pot_entry(char *ciphertext)
 			do {
 				char *source;
 
-				source = crk_methods.source(pw->source,
-				                            pw->binary);
+				source = ldr_pw_source(crk_db->format, pw);
 
 				if (!ldr_pot_source_cmp(ciphertext, source)) {
 					if (crk_process_guess(salt, pw, -1))
@@ -533,7 +594,7 @@ static int crk_remove_pot_entry(char *ciphertext)
 		do {
 			char *source;
 
-			source = crk_methods.source(pw->source, pw->binary);
+			source = ldr_pw_source(crk_db->format, pw);
 
 			//assert(source != ciphertext);
 			if (!strcmp(source, ciphertext)) {
@@ -557,7 +618,7 @@ static int crk_remove_pot_entry(char *ciphertext)
 		do {
 			char *source;
 
-			source = crk_methods.source(pw->source, pw->binary);
+			source = ldr_pw_source(crk_db->format, pw);
 
 			//assert(source != ciphertext);
 			if (!strcmp(source, ciphertext)) {
@@ -573,11 +634,59 @@ static int crk_remove_pot_entry(char *ciphertext)
 	return 0;
 }
 
+void crk_pot_mark(FILE *file)
+{
+	int64_t pos = jtr_ftell64(file);
+	int len = pos < (int64_t)sizeof(crk_pot_tail) ?
+		(int)pos : (int)sizeof(crk_pot_tail);
+
+	crk_pot_pos = pos;
+	crk_pot_tail_len = 0;
+	if (pos > 0 && jtr_fseek64(file, pos - len, SEEK_SET) == 0 &&
+	    fread(crk_pot_tail, 1, len, file) == len)
+		crk_pot_tail_len = len;
+}
+
+void crk_pot_wrote(const char *data, int count)
+{
+	int keep = sizeof(crk_pot_tail) - count;
+
+	crk_pot_pos += count;
+	if (keep <= 0) {
+		memcpy(crk_pot_tail, data - keep, sizeof(crk_pot_tail));
+		crk_pot_tail_len = sizeof(crk_pot_tail);
+		return;
+	}
+	if (keep > crk_pot_tail_len)
+		keep = crk_pot_tail_len;
+	memmove(crk_pot_tail, &crk_pot_tail[crk_pot_tail_len - keep], keep);
+	memcpy(&crk_pot_tail[keep], data, count);
+	crk_pot_tail_len = keep + count;
+}
+
+/*
+ * Whether the pot no longer has what we saw before crk_pot_pos, meaning it
+ * was rewritten (unique -pot=) and has to be read again from the start.
+ */
+static int crk_pot_rewritten(FILE *file)
+{
+	char buf[sizeof(crk_pot_tail)];
+
+	if (!crk_pot_tail_len)
+		return 0;
+	if (jtr_fseek64(file, crk_pot_pos - crk_pot_tail_len, SEEK_SET) ||
+	    fread(buf, 1, crk_pot_tail_len, file) != crk_pot_tail_len)
+		return 1;
+	return memcmp(buf, crk_pot_tail, crk_pot_tail_len) != 0;
+}
+
 int crk_reload_pot(void)
 {
 	char line[LINE_BUFFER_SIZE];
 	FILE *pot_file;
 	int total = crk_db->password_count, others;
+	double sync_start = crk_timing ? crk_get_time() : 0;
+	double sync_guess = crk_stats.guess;
 #ifdef POTSYNC_DEBUG
 	struct tms buffer;
 	clock_t start = times(&buffer), end;
@@ -592,6 +701,12 @@ int crk_reload_pot(void)
 	if (!(pot_file = fopen(path_expand(options.activepot), "rb")))
 		pexit("fopen: %s", path_expand(options.activepot));
 
+	if (crk_pot_pos && crk_pot_rewritten(pot_file)) {
+		log_event("- pot file was rewritten, reading it all again");
+		crk_pot_pos = crk_pot_tail_len = 0;
+		rewind(pot_file);
+	}
+
 	if (crk_pot_pos && (jtr_fseek64(pot_file, crk_pot_pos, SEEK_SET) == -1)) {
 		perror("fseek");
 		rewind(pot_file);
@@ -620,7 +735,7 @@ int crk_reload_pot(void)
 
 	ldr_in_pot = 0;
 
-	crk_pot_pos = jtr_ftell64(pot_file);
+	crk_pot_mark(pot_file);
 
 	if (fclose(pot_file))
 		pexit("fclose");
@@ -647,6 +762,10 @@ int crk_reload_pot(void)
 	fprintf(stderr, "%s(%u): potsync removed %d hashes in %lu ms (%lu ms finding salts); %s\n", __FUNCTION__, options.node_min, others, 1000UL*(end - start)/CLK_TCK, 1000UL * salt_time / CLK_TCK, crk_loaded_counts());
 #endif
 
+	if (crk_timing)
+		crk_stats.pot_sync += crk_get_time() - sync_start -
+			(crk_stats.guess - sync_guess);
+
 	return (!crk_db->salts);
 }
 
@@ -747,6 +866,11 @@ static int crk_process_event(void)
 		status_ticks_overflow_safety();
 	}
 
+	if (event_metrics) {
+		event_metrics = 0;
+		status_metrics_poll();
+	}
+
 	if (event_poll_files) {
 		event_poll_files = 0;
 #if HAVE_LIBDL && defined(HAVE_CUDA) || defined(HAVE_OPENCL)
@@ -758,47 +882,41 @@ static int crk_process_event(void)
 	return event_abort;
 }
 
-static int crk_password_loop(struct db_salt *salt)
+/*
+ * Candidates that reach cmp_one()/cmp_exact() are rare compared to the
+ * number of crypts, so these are counted unconditionally.
+ */
+static MAYBE_INLINE int crk_cmp_one(void *binary, int index)
 {
-	void ext_hybrid_fix_state(void);
-	int count;
-	unsigned int match, index;
+	crk_stats.cmp_one++;
+	return crk_methods.cmp_one(binary, index);
+}
+
+static MAYBE_INLINE int crk_cmp_exact(char *source, int index)
+{
+	crk_stats.cmp_exact++;
+	return crk_methods.cmp_exact(source, index);
+}
+
+/*
+ * Looks up the first match computed hashes among the loaded ones for this
+ * salt, processing any guesses.
+ */
+static int crk_lookup(struct db_salt *salt, unsigned int match)
+{
+	unsigned int index;
 #if CRK_PREFETCH
 	unsigned int target;
 #endif
 
-#if !OS_TIMER
-	sig_timer_emu_tick();
-#endif
-
-	idle_yield();
-
-	if (event_pending && crk_process_event())
-		return -1;
-
-	ext_hybrid_fix_state();
-
-	count = crk_key_index;
-	match = crk_methods.crypt_all(&count, salt);
-	crk_last_key = count;
-
-	{
-		int64 effective_count;
-		mul32by32(&effective_count, salt->count, count);
-		status_update_crypts(&effective_count, count);
-	}
-
-	if (!match)
-		return 0;
-
 	if (!salt->bitmap) {
 		struct db_password *pw = salt->list;
 		do {
 			if (crk_methods.cmp_all(pw->binary, match))
 			for (index = 0; index < match; index++)
-			if (crk_methods.cmp_one(pw->binary, index))
-			if (crk_methods.cmp_exact(crk_methods.source(
-			    pw->source, pw->binary), index)) {
+			if (crk_cmp_one(pw->binary, index))
+			if (crk_cmp_exact(
+			    ldr_pw_source(crk_db->format, pw), index)) {
 				if (crk_process_guess(salt, pw, index))
 					return 1;
 				else {
@@ -811,6 +929,8 @@ static int crk_password_loop(struct db_salt *salt)
 		return 0;
 	}
 
+	crk_stats.probes += match;
+
 #if CRK_PREFETCH
 	for (index = 0; index < match; index = target) {
 		unsigned int slot, ahead, lucky;
@@ -849,6 +969,7 @@ static int crk_password_loop(struct db_salt *salt)
 				a[lucky++].u.p = pwp;
 			}
 		}
+		crk_stats.bitmap_hits += lucky;
 #if 1
 		if (!lucky)
 			continue;
@@ -870,9 +991,9 @@ static int crk_password_loop(struct db_salt *salt)
 			struct db_password *pw = *a[slot].u.p;
 			index = a[slot].i;
 			do {
-				if (crk_methods.cmp_one(pw->binary, index))
-				if (crk_methods.cmp_exact(crk_methods.source(
-				    pw->source, pw->binary), index)) {
+				if (crk_cmp_one(pw->binary, index))
+				if (crk_cmp_exact(
+				    ldr_pw_source(crk_db->format, pw), index)) {
 					if (crk_process_guess(salt, pw, index))
 						return 1;
 /* After we've successfully cracked and removed a hash, our prefetched bitmap
@@ -887,6 +1008,9 @@ static int crk_password_loop(struct db_salt *salt)
 						    PASSWORD_HASH_SHR];
 						if (pw == first || !first) {
 							target = a[slot + 1].i;
+/* Those will be probed (and counted) again */
+							crk_stats.bitmap_hits -=
+							    lucky - slot - 1;
 							lucky = 0;
 						}
 					}
@@ -901,10 +1025,11 @@ static int crk_password_loop(struct db_salt *salt)
 		    (1U << (hash % (sizeof(*salt->bitmap) * 8)))) {
 			struct db_password *pw =
 			    salt->hash[hash >> PASSWORD_HASH_SHR];
+			crk_stats.bitmap_hits++;
 			do {
-				if (crk_methods.cmp_one(pw->binary, index))
-				if (crk_methods.cmp_exact(crk_methods.source(
-				    pw->source, pw->binary), index))
+				if (crk_cmp_one(pw->binary, index))
+				if (crk_cmp_exact(
+				    ldr_pw_source(crk_db->format, pw), index))
 				if (crk_process_guess(salt, pw, index))
 					return 1;
 			} while ((pw = pw->next_hash));
@@ -915,6 +1040,55 @@ static int crk_password_loop(struct db_salt *salt)
 	return 0;
 }
 
+static int crk_password_loop(struct db_salt *salt)
+{
+	void ext_hybrid_fix_state(void);
+	int count;
+	unsigned int match;
+
+#if !OS_TIMER
+	sig_timer_emu_tick();
+#endif
+
+	idle_yield();
+
+	if (event_pending && crk_process_event())
+		return -1;
+
+	ext_hybrid_fix_state();
+
+	count = crk_key_index;
+	if (crk_timing) {
+		double start = crk_get_time();
+
+		match = crk_methods.crypt_all(&count, salt);
+		crk_stats.crypt_all += crk_get_time() - start;
+	} else
+		match = crk_methods.crypt_all(&count, salt);
+	crk_last_key = count;
+
+	{
+		int64 effective_count;
+		mul32by32(&effective_count, salt->count, count);
+		status_update_crypts(&effective_count, count);
+	}
+
+	if (!match)
+		return 0;
+
+	if (crk_timing) {
+		double start = crk_get_time(), guess = crk_stats.guess;
+		int done = crk_lookup(salt, match);
+
+		/* Guesses found here are already accounted for separately */
+		crk_stats.lookup += crk_get_time() - start -
+			(crk_stats.guess - guess);
+		return done;
+	}
+
+	return crk_lookup(salt, match);
+}
+
 static int crk_salt_loop(void)
 {
 	int done;
@@ -942,6 +1116,21 @@ static int crk_salt_loop(void)
 		}
 	}
 	do {
+#if CRK_PREFETCH && defined(__SSE__)
+		/* Have the next salt on its way while this one is being cracked.
+		 * Salts are packed in this order, so mostly this is cheap. */
+		if (salt->next) {
+			struct db_salt *next = salt->next;
+
+			_mm_prefetch((const char *)next->salt, _MM_HINT_T1);
+			if (crk_params.flags & FMT_DYNA_SALT)
+				_mm_prefetch(*(const char **)next->salt,
+				             _MM_HINT_T1);
+			if (next->bitmap)
+				_mm_prefetch((const char *)next->bitmap,
+				             _MM_HINT_T1);
+		}
+#endif
 		crk_methods.set_salt(salt->salt);
 		status.resume_salt_md5 = salt->salt_md5;
 		if ((done = crk_password_loop(salt)))
@@ -991,7 +1180,7 @@ int crk_process_key(char *key)
 		if (crk_key_index == 0)
 			crk_methods.clear_keys();
 
-		crk_methods.set_key(key, crk_key_index++);
+		crk_set_key(key, crk_key_index++);
 
 		if (crk_key_index >= crk_params.max_keys_per_crypt ||
 		    (options.force_maxkeys &&
@@ -1057,7 +1246,7 @@ int crk_process_salt(struct db_salt *salt)
 		strnzcpy(key, ptr, crk_params.plaintext_length + 1);
 		ptr += crk_params.plaintext_length;
 
-		crk_methods.set_key(key, index++);
+		crk_set_key(key, index++);
 		if (index >= crk_params.max_keys_per_crypt || !count ||
 		    (options.force_maxkeys && index >= options.force_maxkeys)) {
 			int done;
@@ -1116,6 +1305,50 @@ char *crk_get_key2(void)
 		return NULL;
 }
 
+void crk_print_stats(void)
+{
+	char prefix[32] = "";
+	double total, other;
+
+	if (!crk_timing || !crk_stats_start)
+		return;
+
+	total = crk_get_time() - crk_stats_start;
+	other = total - crk_stats.crypt_all -
+		crk_stats.lookup - crk_stats.guess - crk_stats.pot_sync;
+	if (other < 0)
+		other = 0;
+	if (total <= 0)
+		total = 1;
+
+	if (options.node_count)
+		snprintf(prefix, sizeof(prefix), "%u: ", options.node_min);
+
+	fprintf(stderr, "%sPhases: generator+set_key %.1f%%, "
+	    "crypt_all %.1f%%, lookup %.1f%%, guesses %.1f%%, "
+	    "pot sync %.1f%%\n",
+	    prefix, 100 * other / total,
+	    100 * crk_stats.crypt_all / total, 100 * crk_stats.lookup / total,
+	    100 * crk_stats.guess / total, 100 * crk_stats.pot_sync / total);
+	fprintf(stderr, "%sCounts: %llu set_key, %llu probes, "
+	    "%llu bitmap hits (%.3f%%), %llu cmp_one, %llu cmp_exact, "
+	    "%llu guesses\n",
+	    prefix, crk_stats.keys, crk_stats.probes, crk_stats.bitmap_hits,
+	    crk_stats.probes ?
+	    100.0 * crk_stats.bitmap_hits / crk_stats.probes : 0.0,
+	    crk_stats.cmp_one, crk_stats.cmp_exact, crk_stats.guesses);
+
+	log_event("Phases: generator+set_key %.1f%%, crypt_all %.1f%%, "
+	    "lookup %.1f%%, guesses %.1f%%, pot sync %.1f%%",
+	    100 * other / total,
+	    100 * crk_stats.crypt_all / total, 100 * crk_stats.lookup / total,
+	    100 * crk_stats.guess / total, 100 * crk_stats.pot_sync / total);
+	log_event("Counts: %llu set_key, %llu probes, %llu bitmap hits, "
+	    "%llu cmp_one, %llu cmp_exact, %llu guesses",
+	    crk_stats.keys, crk_stats.probes, crk_stats.bitmap_hits,
+	    crk_stats.cmp_one, crk_stats.cmp_exact, crk_stats.guesses);
+}
+
 void crk_done(void)
 {
 	if (crk_db->loaded) {
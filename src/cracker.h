@@ -16,6 +16,39 @@
 /* Our last read position in pot file (during crack) */
 extern int64_t crk_pot_pos;
 
+/*
+ * Sets crk_pot_pos to the current position in the pot file and remembers
+ * what precedes it, so that a later pot sync notices if the file has been
+ * rewritten (unique -pot=) rather than just appended to.
+ */
+extern void crk_pot_mark(FILE *file);
+
+/* Advances crk_pot_pos past data we just appended to the pot ourselves */
+extern void crk_pot_wrote(const char *data, int count);
+
+/*
+ * Per-phase hot path counters.  The times (in seconds) are only accumulated
+ * while crk_timing is non-zero (--test-load or PhaseCounters in john.conf).
+ * The lookup time includes the calls to cmp_one()/cmp_exact(); the time
+ * spent processing guesses, whether found by a lookup or replayed from the
+ * pot by a sync, is only counted in guess.  The counts are cheap enough to be always kept.
+ * These are per process: with --fork, each child reports its own.
+ */
+struct crk_stats {
+	double crypt_all, lookup, guess, pot_sync;
+	unsigned long long keys, probes, bitmap_hits, cmp_one, cmp_exact;
+	unsigned long long guesses;
+};
+
+extern int crk_timing;
+extern struct crk_stats crk_stats;
+
+/*
+ * Prints (and logs) a one-line breakdown of where the cracker's time went,
+ * if crk_timing is enabled.
+ */
+extern void crk_print_stats(void);
+
 /*
  * Initializes the cracker for a password database (should not be empty).
  * If fix_state() is not NULL, it will be called when key buffer becomes
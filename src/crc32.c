@@ -75,6 +75,30 @@ void CRC32_Update(CRC32_t *value, void *data, unsigned int count)
 	unsigned char *ptr = (unsigned char*)data;
 	CRC32_t result = *value;
 
+#if CRC32_FOLD
+	if (count >= 64) {
+		CRC32_fold_t fold;
+
+		CRC32_FoldInit(&fold, result,
+		               _mm_loadu_si128((__m128i*)ptr),
+		               _mm_loadu_si128((__m128i*)(ptr + 16)),
+		               _mm_loadu_si128((__m128i*)(ptr + 32)),
+		               _mm_loadu_si128((__m128i*)(ptr + 48)));
+		ptr += 64;
+		count -= 64;
+		while (count >= 64) {
+			CRC32_Fold64(&fold,
+			             _mm_loadu_si128((__m128i*)ptr),
+			             _mm_loadu_si128((__m128i*)(ptr + 16)),
+			             _mm_loadu_si128((__m128i*)(ptr + 32)),
+			             _mm_loadu_si128((__m128i*)(ptr + 48)));
+			ptr += 64;
+			count -= 64;
+		}
+		result = CRC32_FoldFinal(&fold);
+	}
+#endif
+
 	if (count)
 	do {
 		result = JTR_CRC32_table[(result ^ *ptr++) & 0xFF] ^ (result >> 8);
@@ -83,6 +107,48 @@ void CRC32_Update(CRC32_t *value, void *data, unsigned int count)
 	*value = result;
 }
 
+#if CRC32_FOLD
+void CRC32_FoldInit(CRC32_fold_t *fold, CRC32_t value,
+                    __m128i a, __m128i b, __m128i c, __m128i d)
+{
+	fold->x[0] = _mm_xor_si128(a, _mm_cvtsi32_si128(value));
+	fold->x[1] = b;
+	fold->x[2] = c;
+	fold->x[3] = d;
+}
+
+CRC32_t CRC32_FoldFinal(CRC32_fold_t *fold)
+{
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+	const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124LL);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+	const __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+	__m128i x = fold->x[0], t;
+	int i;
+
+	/* Fold 512 bits into 128 */
+	for (i = 1; i < 4; i++) {
+		t = _mm_clmulepi64_si128(x, k3k4, 0x00);
+		x = _mm_clmulepi64_si128(x, k3k4, 0x11);
+		x = _mm_xor_si128(_mm_xor_si128(x, fold->x[i]), t);
+	}
+
+	/* 128 bits into 64 */
+	t = _mm_clmulepi64_si128(x, k3k4, 0x10);
+	x = _mm_xor_si128(_mm_srli_si128(x, 8), t);
+	t = _mm_srli_si128(x, 4);
+	x = _mm_clmulepi64_si128(_mm_and_si128(x, mask), k5k0, 0x00);
+	x = _mm_xor_si128(x, t);
+
+	/* Barrett reduction to 32 bits */
+	t = _mm_clmulepi64_si128(_mm_and_si128(x, mask), poly, 0x10);
+	t = _mm_clmulepi64_si128(_mm_and_si128(t, mask), poly, 0x00);
+	x = _mm_xor_si128(x, t);
+
+	return _mm_extract_epi32(x, 1);
+}
+#endif
+
 void CRC32_Final(unsigned char *out, CRC32_t value)
 {
 	value = ~value;
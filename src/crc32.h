@@ -39,6 +39,54 @@ extern void CRC32_Update(CRC32_t *value, void *data, unsigned int size);
  */
 extern void CRC32_Final(unsigned char *out, CRC32_t value);
 
+/*
+ * Folded CRC-32 using carry-less multiplication (jumbo only).  This is what
+ * CRC32_Update() uses for blocks of 64 bytes or more.  The fold state is
+ * exposed so that code producing its data 64 bytes at a time (such as a
+ * CBC decryption loop) can feed it straight from registers.  The constants
+ * are the bit-reflected k1..k5 and Barrett values from Intel's "Fast CRC
+ * Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+ */
+#if __PCLMUL__ && __SSE4_1__
+#include <immintrin.h>
+
+#define CRC32_FOLD			1
+
+typedef struct {
+	__m128i x[4];
+} CRC32_fold_t;
+
+/*
+ * Starts folding with the current CRC-32 value and the first 64 bytes.
+ */
+extern void CRC32_FoldInit(CRC32_fold_t *fold, CRC32_t value,
+                           __m128i a, __m128i b, __m128i c, __m128i d);
+
+/*
+ * Folds in the next 64 bytes.
+ */
+static inline void CRC32_Fold64(CRC32_fold_t *fold,
+                                __m128i a, __m128i b, __m128i c, __m128i d)
+{
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+
+#define CRC32_FOLD_ONE(x, in) \
+	x = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k1k2, 0x00), \
+	                                _mm_clmulepi64_si128(x, k1k2, 0x11)), in)
+	CRC32_FOLD_ONE(fold->x[0], a);
+	CRC32_FOLD_ONE(fold->x[1], b);
+	CRC32_FOLD_ONE(fold->x[2], c);
+	CRC32_FOLD_ONE(fold->x[3], d);
+#undef CRC32_FOLD_ONE
+}
+
+/*
+ * Reduces the fold state back to a CRC-32 value, which may then be passed
+ * on to CRC32_Update() for any remaining bytes, or to CRC32_Final().
+ */
+extern CRC32_t CRC32_FoldFinal(CRC32_fold_t *fold);
+#endif
+
 /*
  * initialze the table function.  (Jumbo function)
  */
@@ -192,10 +192,15 @@ typedef struct cryptloopstruct_t {
 	unsigned char buf[8*2*64*BLKS];	// will allocate to hold 42 2 block buffers (42 * 2 * 64)  Reduced to only requiring 8*2*64
 								// now, the cryptstructs are on the stack within the crypt for loop, so we avoid allocation.
 								// and to avoid the single static variable, or a static array.
-	unsigned char *bufs[BLKS][42];	// points to the start of each 2 block buffer.
 #ifdef SIMD_COEF_32
-	int offs[BLKS][42];
+	ARCH_WORD_32 ibuf[8*2*16*BLKS];	// buf, converted once into SIMD interleaved (mixed) BE words.  The inner
+								// loop crypts straight from here, so there is no per round gather/swap.
+	unsigned char ibufs[42];	// which of the 8 interleaved buffers is crypted in each round.
+	unsigned char icptr[42];	// which of the 8 interleaved buffers receives the crypt of each round.
+	unsigned short ioffs[BLKS][42];	// byte offset of the crypt within that buffer, for each lane.
+	unsigned char iuniform[42];	// 1 if all lanes share the same offset (so the insert can be done across lanes).
 #endif
+	unsigned char *bufs[BLKS][42];	// points to the start of each 2 block buffer.
 	unsigned char *cptr[BLKS][42];	// points to where we copy the crypt pointer for next round.
 								// Round 0 points to somewhere in round 1's buffer, etc.
 	int datlen[42];				// if 1, then this is a small, only 1 block crypt. Some rounds for shorter passwords take only 1 crypt block.
@@ -585,6 +590,88 @@ static void LoadCryptStruct(cryptloopstruct *crypt_struct, int index, int idx, c
 	if (!idx) pstr->datlen[41] = dlen_ppsc;
 }
 
+#ifdef SIMD_COEF_32
+/* ibuf word index of 32 bit BE word w (0..31) of lane k, within one of the 8 buffers */
+#define IBUF_POS(k,w) ( ((w)>>4)*16*BLKS + ((k)/SIMD_COEF_32)*16*SIMD_COEF_32 + ((w)&15)*SIMD_COEF_32 + ((k)&(SIMD_COEF_32-1)) )
+
+/* Once all lanes have been loaded, turn the flat BE byte buffers into the     */
+/* interleaved word layout SIMDSHA256body() wants for SSEi_MIXED_IN, and work  */
+/* out (from the flat pointers) which buffer and offset each round touches.   */
+static void LoadInterleaved(cryptloopstruct *pstr) {
+	ARCH_WORD_32 *flat = (ARCH_WORD_32 *)pstr->buf;
+	int t, k, w, i;
+
+	for (t = 0; t < 8; ++t)
+		for (k = 0; k < BLKS; ++k)
+			for (w = 0; w < 32; ++w)
+				pstr->ibuf[t*32*BLKS+IBUF_POS(k,w)] = JOHNSWAP(flat[t*32*BLKS+k*32+w]);
+	for (i = 0; i < 42; ++i) {
+		pstr->ibufs[i] = (pstr->bufs[0][i] - pstr->buf) / (128*BLKS);
+		pstr->icptr[i] = (pstr->cptr[0][i] - pstr->buf) / (128*BLKS);
+		pstr->iuniform[i] = 1;
+		for (k = 0; k < BLKS; ++k) {
+			pstr->ioffs[k][i] = (pstr->cptr[k][i] - pstr->buf) % (128*BLKS) - k*128;
+			if (pstr->ioffs[k][i] != pstr->ioffs[0][i])
+				pstr->iuniform[i] = 0;
+		}
+	}
+}
+
+/* Insert this round's crypt (sse_out) for every lane, directly into the      */
+/* interleaved buffer of the next round.  The offset is only byte aligned, so */
+/* the 32 byte crypt straddles 9 BE words, unless it happens to be 4 aligned. */
+static void InsertCrypt(cryptloopstruct *pstr, ARCH_WORD_32 *sse_out, int idx) {
+	ARCH_WORD_32 *W = &pstr->ibuf[pstr->icptr[idx]*32*BLKS];
+	int j, k;
+
+	if (pstr->iuniform[idx]) {
+		// same offset in every lane, so do a whole SIMD word at a time.
+		unsigned off = pstr->ioffs[0][idx], q = off >> 2, r = (off & 3) << 3;
+		const ARCH_WORD_32 keep = ~(0xFFFFFFFF >> r);
+		int l;
+
+		for (k = 0; k < BLKS; k += SIMD_COEF_32) {
+			const ARCH_WORD_32 *c = &sse_out[(k/SIMD_COEF_32)*8*SIMD_COEF_32];
+			ARCH_WORD_32 *p;
+
+			if (!r) {
+				for (j = 0; j < 8; ++j)
+					memcpy(&W[IBUF_POS(k,q+j)], &c[j*SIMD_COEF_32], SIMD_COEF_32*4);
+				continue;
+			}
+			p = &W[IBUF_POS(k,q)];
+			for (l = 0; l < SIMD_COEF_32; ++l)
+				p[l] = (p[l] & keep) | (c[l] >> r);
+			for (j = 1; j < 8; ++j) {
+				p = &W[IBUF_POS(k,q+j)];
+				for (l = 0; l < SIMD_COEF_32; ++l)
+					p[l] = (c[(j-1)*SIMD_COEF_32+l] << (32-r)) | (c[j*SIMD_COEF_32+l] >> r);
+			}
+			p = &W[IBUF_POS(k,q+8)];
+			for (l = 0; l < SIMD_COEF_32; ++l)
+				p[l] = (c[7*SIMD_COEF_32+l] << (32-r)) | (p[l] & ~keep);
+		}
+		return;
+	}
+	for (k = 0; k < BLKS; ++k) {
+		const ARCH_WORD_32 *c = &sse_out[(k/SIMD_COEF_32)*8*SIMD_COEF_32+(k&(SIMD_COEF_32-1))];
+		unsigned off = pstr->ioffs[k][idx], q = off >> 2, r = (off & 3) << 3;
+
+		if (!r) {
+			for (j = 0; j < 8; ++j)
+				W[IBUF_POS(k,q+j)] = c[j*SIMD_COEF_32];
+		} else {
+			ARCH_WORD_32 *p = &W[IBUF_POS(k,q)];
+			*p = (*p & ~(0xFFFFFFFF >> r)) | (c[0] >> r);
+			for (j = 1; j < 8; ++j)
+				W[IBUF_POS(k,q+j)] = (c[(j-1)*SIMD_COEF_32] << (32-r)) | (c[j*SIMD_COEF_32] >> r);
+			p = &W[IBUF_POS(k,q+8)];
+			*p = (c[7*SIMD_COEF_32] << (32-r)) | (*p & (0xFFFFFFFF >> r));
+		}
+	}
+}
+#endif
+
 static int crypt_all(int *pcount, struct db_salt *salt)
 {
 	const int count = *pcount;
@@ -746,25 +833,15 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 
 		idx = 0;
 #ifdef SIMD_COEF_32
+		LoadInterleaved(crypt_struct);
 		for (cnt = 1; ; ++cnt) {
-			if (crypt_struct->datlen[idx]==128) {
-				unsigned char *cp = crypt_struct->bufs[0][idx];
-				SIMDSHA256body((__m128i *)cp, sse_out, NULL, SSEi_FLAT_IN|SSEi_2BUF_INPUT_FIRST_BLK);
-				SIMDSHA256body((__m128i *)&cp[64], sse_out, sse_out, SSEi_FLAT_IN|SSEi_2BUF_INPUT_FIRST_BLK|SSEi_RELOAD);
-			} else {
-				unsigned char *cp = crypt_struct->bufs[0][idx];
-				SIMDSHA256body((__m128i *)cp, sse_out, NULL, SSEi_FLAT_IN|SSEi_2BUF_INPUT_FIRST_BLK);
-			}
+			ARCH_WORD_32 *ip = &crypt_struct->ibuf[crypt_struct->ibufs[idx]*32*BLKS];
+			SIMDSHA256body((__m128i *)ip, sse_out, NULL, SSEi_MIXED_IN);
+			if (crypt_struct->datlen[idx]==128)
+				SIMDSHA256body((__m128i *)&ip[16*BLKS], sse_out, sse_out, SSEi_MIXED_IN|SSEi_RELOAD);
 			if (cnt == cur_salt->rounds)
 				break;
-			{
-				unsigned int j, k;
-				for (k = 0; k < MAX_KEYS_PER_CRYPT; ++k) {
-					ARCH_WORD_32 *o = (ARCH_WORD_32 *)crypt_struct->cptr[k][idx];
-					for (j = 0; j < 8; ++j)
-						*o++ = JOHNSWAP(sse_out[(j*SIMD_COEF_32)+(k&(SIMD_COEF_32-1))+k/SIMD_COEF_32*8*SIMD_COEF_32]);
-				}
-			}
+			InsertCrypt(crypt_struct, sse_out, idx);
 			if (++idx == 42)
 				idx = 0;
 		}
@@ -53,8 +53,9 @@ static int omp_t = 1;
 #define BINARY_ALIGN		4
 #define SALT_ALIGN		4
 
-#define MIN_KEYS_PER_CRYPT	1
-#define MAX_KEYS_PER_CRYPT	1
+#define SCRYPT_X		2 // candidates interleaved per escrypt_kdf_x() call
+#define MIN_KEYS_PER_CRYPT	SCRYPT_X
+#define MAX_KEYS_PER_CRYPT	SCRYPT_X
 
 /* notastrongpassword => scrypt$NBGmaGIXijJW$14$8$1$64$achPt01SbytSt+F3CcCFgEPr96+/j9iCTdejFdAARZ8mzfejrP64TJ5XBJa3gYwuCKOEGlw2E/lWCWS7LeS6CA== */
 
@@ -67,6 +68,9 @@ static struct fmt_tests scrypt_tests[] = {
 
 static char (*saved_key)[PLAINTEXT_LENGTH + 1];
 static ARCH_WORD_32 (*crypt_out)[BINARY_SIZE / sizeof(ARCH_WORD_32)];
+/* one per SCRYPT_X keys, so V is allocated once and reused across calls */
+static escrypt_local_t *local;
+static int local_count;
 
 static struct custom_salt {
 	/* int type; */ // not used (another type probably required a new JtR format)
@@ -78,6 +82,8 @@ static struct custom_salt {
 
 static void init(struct fmt_main *self)
 {
+	int i;
+
 #ifdef _OPENMP
 	omp_t = omp_get_max_threads();
 	self->params.min_keys_per_crypt *= omp_t;
@@ -88,10 +94,19 @@ static void init(struct fmt_main *self)
 	                       sizeof(*saved_key));
 	crypt_out = mem_calloc(self->params.max_keys_per_crypt,
 	                       sizeof(*crypt_out));
+	local_count = self->params.max_keys_per_crypt / SCRYPT_X;
+	local = mem_calloc(local_count, sizeof(*local));
+	for (i = 0; i < local_count; i++)
+		escrypt_init_local(&local[i]);
 }
 
 static void done(void)
 {
+	int i;
+
+	for (i = 0; i < local_count; i++)
+		escrypt_free_local(&local[i]);
+	MEM_FREE(local);
 	MEM_FREE(crypt_out);
 	MEM_FREE(saved_key);
 }
@@ -193,16 +208,26 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 
 #ifdef _OPENMP
 #pragma omp parallel for
-	for (index = 0; index < count; index++)
 #endif
+	for (index = 0; index < count; index += SCRYPT_X)
 	{
-		if (crypto_scrypt((unsigned char*)saved_key[index], strlen((char*)saved_key[index]),
+		const uint8_t *key[SCRYPT_X];
+		size_t len[SCRYPT_X];
+		uint8_t *out[SCRYPT_X];
+		int i, n = MIN(count - index, SCRYPT_X);
+
+		for (i = 0; i < n; i++) {
+			key[i] = (uint8_t*)saved_key[index + i];
+			len[i] = strlen(saved_key[index + i]);
+			out[i] = (uint8_t*)crypt_out[index + i];
+		}
+		if (escrypt_kdf_x(&local[index / SCRYPT_X], n, key, len,
 				cur_salt->salt, strlen((char*)cur_salt->salt),
 				(1ULL) << cur_salt->N, cur_salt->r,
-				cur_salt->p, (unsigned char*)crypt_out[index],
-				BINARY_SIZE) == -1)
+				cur_salt->p, out, BINARY_SIZE) == -1)
 		{
-			memset(crypt_out[index], 0, sizeof(crypt_out[index]));
+			for (i = 0; i < n; i++)
+				memset(crypt_out[index + i], 0, sizeof(crypt_out[index + i]));
 		}
 	}
 	return count;
@@ -211,9 +236,8 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 static int cmp_all(void *binary, int count)
 {
 	int index = 0;
-#ifdef _OPENMP
+
 	for (; index < count; index++)
-#endif
 		if (!memcmp(binary, crypt_out[index], ARCH_SIZE))
 			return 1;
 	return 0;
@@ -957,6 +957,13 @@ static char *comp_optimize_script_mixed(char *pScr, char *pParams) {
 				}
 			}
 			if (*cpI == 'F' && cpI[1] == 'u') {
+				// the in-place base16 key script (bOffsetHashIn1) truncates input1 back to
+				// the hex.  In SIMD buffers the 0x80 has to be moved back down also.
+				if (!strncmp(cpI, "Func=DynamicFunc__set_input_len_32\n", 35)) {
+					cpO += sprintf(cpO, "Func=DynamicFunc__set_input_len_32_cleartop\n");
+					cpI += 35;
+					continue;
+				}
 				// might be 'Func=crypt'
 				if (!strncmp(cpI, "Func=DynamicFunc__MD5_crypt", 27)) {
 					if (!strncmp(cpI, "Func=DynamicFunc__MD5_crypt_input1_to_output1_FINAL\n", 52)) {
@@ -1158,19 +1165,23 @@ SkipSaltCheck:;
 					// Make SURE there is something 'more' than just hash($p).  If not, we
 					// have code that is FASTER than using this optimization, so let this
 					// one NOT be optimized in this way.
-					n1 = 0;
+					int n_dollar = 0;
 					p = strchr(pBuf, '$');
 					while (p) {
-						++n1;
+						++n_dollar;
 						p = strchr(&p[1], '$');
 					}
-					if (n1 > 1) {
+					if (n_dollar > 1) {
 						// we can MGF_KEYS_BASE16_IN1
 						keys_base16_in1_type = mem_alloc(strlen(cpType)+1);
 						strcpy(keys_base16_in1_type, cpType);
-						// see if this is a bOffsetHashIn1 type.
+						// see if this is a bOffsetHashIn1 type.  If the one hash($p) is the
+						// very first thing the outer hash sees, the base16 of it is already
+						// sitting at the start of input1.  The script then simply truncates
+						// input1 back to the hex length and appends to it in place, instead
+						// of clearing input2 and copying input1 into it for every salt.
 						if (n1 == 1) {
-							p = strchr(pExpr, '(');
+							p = strchr(pBuf, '(');
 							++p;
 							if (!strncmp(p, cpType, strlen(cpType)))
 								bOffsetHashIn1=1;
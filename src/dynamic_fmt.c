@@ -60,7 +60,14 @@ static DYNAMIC_primitive_funcp _Funcs_1[] =
 
 #include "arch.h"
 
-#if !FAST_FORMATS_OMP
+/*
+ * Unlike the other fast formats, dynamic keeps OpenMP by default: crypt_all
+ * splits each batch across the threads.  Build with --disable-openmp-for-dynamic
+ * (DYNAMIC_DISABLE_OMP) to get the old single threaded code.  This must match
+ * in dynamic_parser.c, dynamic_preloads.c, dynamic_utils.c and the big crypt
+ * code, since it changes the prototype of every primitive.
+ */
+#if !FAST_FORMATS_OMP && DYNAMIC_DISABLE_OMP
 #ifdef _OPENMP
 #  define FORCE_THREAD_MD5_body
 #endif
@@ -539,6 +546,9 @@ static int valid(char *ciphertext, struct fmt_main *pFmt)
 static char *FixupIfNeeded(char *ciphertext, private_subformat_data *pPriv);
 static struct fmt_main *dynamic_Get_fmt_main(int which);
 static char *HandleCase(char *cp, int caseType);
+#ifdef _OPENMP
+static int isBadOMPFunc(DYNAMIC_primitive_funcp p);
+#endif
 
 // 'wrapper' functions. These are here, so we can call these functions to work on ALL data (not simply within the
 // thead, which ONLY wants to work on a subset of the data.  These functions should NOT be called by threading
@@ -1741,25 +1751,42 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 #ifdef _OPENMP
 	if ((curdat.pFmtMain->params.flags & FMT_OMP) == FMT_OMP) {
 		int j;
-		unsigned int inc = (m_count+m_ompt-1) / m_ompt;
+		unsigned int inc = (m_count+m_ompt-1) / m_ompt, first = 0;
 		//printf ("maxkeys=%d m_count=%d inc1=%d granularity=%d inc2=%d\n", curdat.pFmtMain->params.max_keys_per_crypt, m_count, inc, curdat.omp_granularity, ((inc + curdat.omp_granularity-1)/curdat.omp_granularity)*curdat.omp_granularity);
 		inc = ((inc + curdat.omp_granularity-1)/curdat.omp_granularity)*curdat.omp_granularity;
-#pragma omp parallel for shared(curdat, inc, m_count)
-		for (j = 0; j < m_count; j += inc) {
-			unsigned int i;
-			unsigned int top=j+inc;
-			/* The last block may 'appear' to have more keys than we have in the
-			   entire buffer space.  This is due to the granularity.  If so,
-			   reduce that last one to stop at end of our buffers.  NOT doing
-			   this is causes a huge buffer overflow.  */
-			if (top > curdat.pFmtMain->params.max_keys_per_crypt)
-				top = curdat.pFmtMain->params.max_keys_per_crypt;
-
-			// we now run a full script in this thread, using only a subset of
-			// the data, from [j,top)  The next thread will run from [top,top+inc)
-			// each thread will take the next inc values, until we get to m_count
-			for (i = 0; curdat.dynamic_FUNCTIONS[i]; ++i)
-				(*(curdat.dynamic_FUNCTIONS[i]))(j,top,omp_get_thread_num());
+		// The script is run in segments.  Functions which switch global state
+		// (SSE<->X86 buffer switches, base16 case) end a segment, and are run
+		// once, over all of the data, before the next segment starts.  The
+		// schedule is static, so a given block of keys lands on the same thread
+		// (and its per-thread unicode/large-hash output state) in every segment.
+		while (curdat.dynamic_FUNCTIONS[first]) {
+			unsigned int last = first;
+
+			while (curdat.dynamic_FUNCTIONS[last] && !isBadOMPFunc(curdat.dynamic_FUNCTIONS[last]))
+				++last;
+			if (last > first) {
+#pragma omp parallel for schedule(static) shared(curdat, inc, m_count, first, last)
+				for (j = 0; j < m_count; j += inc) {
+					unsigned int i;
+					unsigned int top=j+inc;
+					/* The last block may 'appear' to have more keys than we have in the
+					   entire buffer space.  This is due to the granularity.  If so,
+					   reduce that last one to stop at end of our buffers.  NOT doing
+					   this is causes a huge buffer overflow.  */
+					if (top > curdat.pFmtMain->params.max_keys_per_crypt)
+						top = curdat.pFmtMain->params.max_keys_per_crypt;
+
+					// we now run this part of the script in this thread, using only a subset
+					// of the data, from [j,top)  The next thread will run from [top,top+inc)
+					// each thread will take the next inc values, until we get to m_count
+					for (i = first; i < last; ++i)
+						(*(curdat.dynamic_FUNCTIONS[i]))(j,top,omp_get_thread_num());
+				}
+			}
+			if (!curdat.dynamic_FUNCTIONS[last])
+				break;
+			(*(curdat.dynamic_FUNCTIONS[last]))(0,m_count,0);
+			first = last + 1;
 		}
 	} else {
 		unsigned int i;
@@ -2809,7 +2836,7 @@ static struct fmt_main fmt_Dynamic =
 		MAX_KEYS_PER_CRYPT_X86,
 #endif
 #ifdef _OPENMP
-		FMT_OMP | FMT_OMP_BAD |
+		FMT_OMP |
 #endif
 		FMT_CASE | FMT_8_BIT,
 		{ NULL },
@@ -2992,6 +3019,24 @@ static void __SSE_overwrite_output_base16_to_input(ARCH_WORD_32 *IPBdw, unsigned
 #undef inc
 }
 
+// Whole SIMD blocks (all lanes start at offset 0) are done a vector at a time
+// by SIMDhex_out_32(); a ragged start or end (OMP split) falls back per lane.
+static void __SSE_overwrite_output_base16_to_input_range(union SIMD_inpup *IPB, union SIMD_crypt *CRY, unsigned int j, unsigned int til)
+{
+	int upper = (itoa16_w2 == itoa16_w2_u);
+
+	while (j < til) {
+		unsigned int idx = j/SIMD_COEF_32;
+		if (!(j&(SIMD_COEF_32-1)) && j+SIMD_COEF_32 <= til) {
+			SIMDhex_out_32(IPB[idx].w, CRY[idx].w, 4, upper);
+			j += SIMD_COEF_32;
+		} else {
+			__SSE_overwrite_output_base16_to_input(IPB[idx].w, CRY[idx].c, j&(SIMD_COEF_32-1));
+			++j;
+		}
+	}
+}
+
 static void __SSE_append_output_base16_to_input_semi_aligned_2(unsigned int ip, ARCH_WORD_32 *IPBdw, unsigned char *CRY, unsigned int idx_mod)
 {
 	// #1
@@ -5685,12 +5730,7 @@ void DynamicFunc__overwrite_from_last_output2_to_input1_as_base16_no_size_fix(DY
 #endif
 #ifdef SIMD_COEF_32
 	if (dynamic_use_sse==1) {
-		unsigned int idx;
-		for (; j < til; ++j)
-		{
-			idx = ( ((unsigned int)j)/SIMD_COEF_32);
-			__SSE_overwrite_output_base16_to_input(input_buf[idx].w, crypt_key2[idx].c, j&(SIMD_COEF_32-1));
-		}
+		__SSE_overwrite_output_base16_to_input_range(input_buf, crypt_key2, j, til);
 		return;
 	}
 #endif
@@ -5730,12 +5770,7 @@ void DynamicFunc__overwrite_from_last_output_as_base16_no_size_fix(DYNA_OMP_PARA
 #endif
 #ifdef SIMD_COEF_32
 	if (dynamic_use_sse==1) {
-		unsigned int idx;
-		for (; j < til; ++j)
-		{
-			idx = ( ((unsigned int)j)/SIMD_COEF_32);
-			__SSE_overwrite_output_base16_to_input(input_buf[idx].w, crypt_key[idx].c, j&(SIMD_COEF_32-1));
-		}
+		__SSE_overwrite_output_base16_to_input_range(input_buf, crypt_key, j, til);
 		return;
 	}
 #endif
@@ -5926,12 +5961,7 @@ void DynamicFunc__overwrite_from_last_output_to_input2_as_base16_no_size_fix(DYN
 #endif
 #ifdef SIMD_COEF_32
 	if (dynamic_use_sse==1) {
-		unsigned int idx;
-		for (; i < til; ++i)
-		{
-			idx = ( ((unsigned int)i)/SIMD_COEF_32);
-			__SSE_overwrite_output_base16_to_input(input_buf2[idx].w, crypt_key[idx].c, i&(SIMD_COEF_32-1));
-		}
+		__SSE_overwrite_output_base16_to_input_range(input_buf2, crypt_key, i, til);
 		return;
 	}
 #endif
@@ -5967,12 +5997,7 @@ void DynamicFunc__overwrite_from_last_output2_to_input2_as_base16_no_size_fix(DY
 #endif
 #ifdef SIMD_COEF_32
 	if (dynamic_use_sse==1) {
-		unsigned int idx;
-		for (; i < til; ++i)
-		{
-			idx = ( ((unsigned int)i)/SIMD_COEF_32);
-			__SSE_overwrite_output_base16_to_input(input_buf2[idx].w, crypt_key2[idx].c, i&(SIMD_COEF_32-1));
-		}
+		__SSE_overwrite_output_base16_to_input_range(input_buf2, crypt_key2, i, til);
 		return;
 	}
 #endif
@@ -6012,12 +6037,7 @@ void DynamicFunc__overwrite_from_last_output2_as_base16_no_size_fix(DYNA_OMP_PAR
 #endif
 #ifdef SIMD_COEF_32
 	if (dynamic_use_sse==1) {
-		unsigned int idx;
-		for (; i < til; ++i)
-		{
-			idx = ( ((unsigned int)i)/SIMD_COEF_32);
-			__SSE_overwrite_output_base16_to_input(input_buf2[idx].w, crypt_key2[idx].c, i&(SIMD_COEF_32-1));
-		}
+		__SSE_overwrite_output_base16_to_input_range(input_buf2, crypt_key2, i, til);
 		return;
 	}
 #endif
@@ -7030,7 +7050,8 @@ static DYNAMIC_primitive_funcp *ConvertFuncs(DYNAMIC_primitive_funcp p, unsigned
 #ifdef _OPENMP
 static int isBadOMPFunc(DYNAMIC_primitive_funcp p)
 {
-	// If ANY of these functions are seen, we can NOT use OMP for this single format.
+	// These functions change global state, so they can NOT be run inside of the
+	// threads.  crypt_all() runs them on their own, between threaded segments.
 #if SIMD_COEF_32
 	if (p==DynamicFunc__SSEtoX86_switch_input1   || p==DynamicFunc__SSEtoX86_switch_input2   ||
 		p==DynamicFunc__SSEtoX86_switch_output1  || p==DynamicFunc__SSEtoX86_switch_output2  ||
@@ -7222,10 +7243,6 @@ static void dyna_setupOMP(DYNAMIC_Setup *Setup, struct fmt_main *pFmt)
 		}
 	}
 #endif
-	for (i=0; Setup->pFuncs[i]; ++i) {
-		if (isBadOMPFunc(Setup->pFuncs[i]))
-			pFmt->params.flags &= (~(FMT_OMP|FMT_OMP_BAD));
-	}
 	if ((pFmt->params.flags&FMT_OMP)==FMT_OMP && (curdat.pSetup->startFlags&MGF_POOR_OMP)==MGF_POOR_OMP)
 		pFmt->params.flags |= FMT_OMP_BAD;
 }
@@ -7322,6 +7339,17 @@ int dynamic_SETUP(DYNAMIC_Setup *Setup, struct fmt_main *pFmt)
 #else
 	pFmt->params.max_keys_per_crypt = MAX_KEYS_PER_CRYPT_X86;
 	pFmt->params.algorithm_name = ALGORITHM_NAME_X86;
+#endif
+#ifdef _OPENMP
+	// The buffers are sized for the most threads OMP_SCALE allows, but we only
+	// ask for what the threads in use need: each thread gets the same block of
+	// keys that a non-OMP build uses for a whole crypt_all call.
+	{
+		unsigned int mkpc = NON_OMP_MAX * omp_get_max_threads();
+
+		if (mkpc < pFmt->params.max_keys_per_crypt)
+			pFmt->params.max_keys_per_crypt = mkpc;
+	}
 #endif
 	pFmt->params.min_keys_per_crypt = pFmt->params.max_keys_per_crypt;
 	if (pFmt->params.min_keys_per_crypt > 64)
@@ -31,7 +31,7 @@
 
 #include "arch.h"
 
-#if !FAST_FORMATS_OMP
+#if !FAST_FORMATS_OMP && DYNAMIC_DISABLE_OMP
 #ifdef _OPENMP
 #  define FORCE_THREAD_MD5_body
 #endif
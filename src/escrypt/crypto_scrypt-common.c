@@ -107,38 +107,43 @@ const uint8_t * decode64_uint32(uint32_t * dst, uint32_t dstbits,
 	return src;
 }
 
-uint8_t *
-escrypt_r(escrypt_local_t * local,
-    const uint8_t * passwd, size_t passwdlen,
+int
+escrypt_r_x(escrypt_local_t * local, int n,
+    const uint8_t * const * passwd, const size_t * passwdlen,
     const uint8_t * setting,
-    uint8_t * buf, size_t buflen)
+    uint8_t * const * buf, size_t buflen)
 {
-	uint8_t hash[HASH_SIZE];
+	uint8_t hash[ESCRYPT_MAX_X][HASH_SIZE];
+	uint8_t * hashp[ESCRYPT_MAX_X];
 	const uint8_t * src, * salt;
 	uint8_t * dst;
 	size_t prefixlen, saltlen, need;
 	uint64_t N;
 	uint32_t r, p;
+	int l;
+
+	if (n < 1 || n > ESCRYPT_MAX_X)
+		return -1;
 
 	if (setting[0] != '$' || setting[1] != '7' || setting[2] != '$')
-		return NULL;
+		return -1;
 	src = setting + 3;
 
 	{
 		uint32_t N_log2;
 		if (decode64_one(&N_log2, *src))
-			return NULL;
+			return -1;
 		src++;
 		N = (uint64_t)1 << N_log2;
 	}
 
 	src = decode64_uint32(&r, 30, src);
 	if (!src)
-		return NULL;
+		return -1;
 
 	src = decode64_uint32(&p, 30, src);
 	if (!src)
-		return NULL;
+		return -1;
 
 	prefixlen = src - setting;
 
@@ -151,24 +156,41 @@ escrypt_r(escrypt_local_t * local,
 
 	need = prefixlen + saltlen + 1 + HASH_LEN + 1;
 	if (need > buflen || need < saltlen)
-		return NULL;
+		return -1;
 
-	if (escrypt_kdf(local, passwd, passwdlen, salt, saltlen,
-	    N, r, p, hash, sizeof(hash)))
-		return NULL;
+	for (l = 0; l < n; l++)
+		hashp[l] = hash[l];
+	if (escrypt_kdf_x(local, n, passwd, passwdlen, salt, saltlen,
+	    N, r, p, hashp, sizeof(hash[0])))
+		return -1;
 
-	dst = buf;
-	memcpy(dst, setting, prefixlen + saltlen);
-	dst += prefixlen + saltlen;
-	*dst++ = '$';
+	for (l = 0; l < n; l++) {
+		dst = buf[l];
+		memcpy(dst, setting, prefixlen + saltlen);
+		dst += prefixlen + saltlen;
+		*dst++ = '$';
 
-	dst = encode64(dst, buflen - (dst - buf), hash, sizeof(hash));
-	/* Could zeroize hash[] here, but escrypt_kdf() doesn't zeroize its
-	 * memory allocations yet anyway. */
-	if (!dst || dst >= buf + buflen) /* Can't happen */
-		return NULL;
+		dst = encode64(dst, buflen - (dst - buf[l]), hash[l],
+		    sizeof(hash[l]));
+		/* Could zeroize hash[] here, but escrypt_kdf() doesn't zeroize
+		 * its memory allocations yet anyway. */
+		if (!dst || dst >= buf[l] + buflen) /* Can't happen */
+			return -1;
 
-	*dst = 0; /* NUL termination */
+		*dst = 0; /* NUL termination */
+	}
+
+	return 0;
+}
+
+uint8_t *
+escrypt_r(escrypt_local_t * local,
+    const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * setting,
+    uint8_t * buf, size_t buflen)
+{
+	if (escrypt_r_x(local, 1, &passwd, &passwdlen, setting, &buf, buflen))
+		return NULL;
 
 	return buf;
 }
@@ -338,3 +338,33 @@ escrypt_kdf(escrypt_local_t * local,
 	/* Success! */
 	return 0;
 }
+
+/**
+ * escrypt_kdf_x(local, n, passwd, passwdlen, salt, saltlen,
+ *     N, r, p, buf, buflen):
+ * As escrypt_kdf(), for the n (1 to ESCRYPT_MAX_X) candidates passwd[l],
+ * writing the results into buf[l].  Without SSE2 there is no interleaved
+ * SMix, so the candidates are simply done one after another.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int
+escrypt_kdf_x(escrypt_local_t * local, int n,
+    const uint8_t * const * passwd, const size_t * passwdlen,
+    const uint8_t * salt, size_t saltlen,
+    uint64_t N, uint32_t r, uint32_t p,
+    uint8_t * const * buf, size_t buflen)
+{
+	int l;
+
+	if (n < 1 || n > ESCRYPT_MAX_X) {
+		errno = EINVAL;
+		return -1;
+	}
+	for (l = 0; l < n; l++)
+		if (escrypt_kdf(local, passwd[l], passwdlen[l], salt, saltlen,
+		    N, r, p, buf[l], buflen))
+			return -1;
+
+	return 0;
+}
@@ -215,106 +215,150 @@ integerify(const void * B, size_t r)
 }
 
 /**
- * smix(B, r, N, V, XY):
- * Compute B = SMix_r(B, N).  The input B must be 128r bytes in length;
- * the temporary storage V must be 128rN bytes in length; the temporary
- * storage XY must be 256r + 64 bytes in length.  The value N must be a
+ * smix_x(B, n, r, N, V, XY):
+ * Compute B[l] = SMix_r(B[l], N) for the n (at most ESCRYPT_MAX_X)
+ * candidates l.  Each input B[l] must be 128r bytes in length; each
+ * temporary storage V[l] must be 128rN bytes in length; each temporary
+ * storage XY[l] must be 256r + 64 bytes in length.  The value N must be a
  * power of 2 greater than 1.  The arrays B, V, and XY must be aligned to a
  * multiple of 64 bytes.
+ *
+ * The candidates are stepped in lockstep.  Once a candidate's next V_j is
+ * known it is prefetched, and is then in cache by the time the BlockMix of
+ * the other candidates is done.
  */
 static void
-smix(uint8_t * B, size_t r, uint32_t N, void * V, void * XY)
+smix_x(uint8_t ** B, int n, size_t r, uint32_t N, void ** V, void ** XY)
 {
 	size_t s = 128 * r;
-	__m128i * X = V, * Y;
-	uint32_t * X32 = V;
-	uint32_t i, j;
+	__m128i * X[ESCRYPT_MAX_X], * Y[ESCRYPT_MAX_X];
+	uint32_t j[ESCRYPT_MAX_X];
+	uint32_t * X32;
+	uint32_t i;
 	size_t k;
+	int l;
 
-	/* 1: X <-- B */
-	/* 3: V_i <-- X */
-	for (k = 0; k < 2 * r; k++) {
-		for (i = 0; i < 16; i++) {
-			X32[k * 16 + i] =
-			    le32dec(&B[(k * 16 + (i * 5 % 16)) * 4]);
+#define PREFETCH_V(l) \
+	for (k = 0; k < s; k += 64) \
+		_mm_prefetch((const char *)V[l] + (size_t)j[l] * s + k, \
+		    _MM_HINT_T0);
+
+	for (l = 0; l < n; l++) {
+		/* 1: X <-- B */
+		/* 3: V_i <-- X */
+		X[l] = V[l];
+		X32 = V[l];
+		for (k = 0; k < 2 * r; k++) {
+			for (i = 0; i < 16; i++) {
+				X32[k * 16 + i] =
+				    le32dec(&B[l][(k * 16 + (i * 5 % 16)) * 4]);
+			}
 		}
 	}
 
 	/* 2: for i = 0 to N - 1 do */
 	for (i = 1; i < N - 1; i += 2) {
+		for (l = 0; l < n; l++) {
+			/* 4: X <-- H(X) */
+			/* 3: V_i <-- X */
+			Y[l] = (void *)((uintptr_t)(V[l]) + i * s);
+			blockmix_salsa8(X[l], Y[l], r);
+		}
+
+		for (l = 0; l < n; l++) {
+			/* 4: X <-- H(X) */
+			/* 3: V_i <-- X */
+			X[l] = (void *)((uintptr_t)(V[l]) + (i + 1) * s);
+			blockmix_salsa8(Y[l], X[l], r);
+		}
+	}
+
+	for (l = 0; l < n; l++) {
 		/* 4: X <-- H(X) */
 		/* 3: V_i <-- X */
-		Y = (void *)((uintptr_t)(V) + i * s);
-		blockmix_salsa8(X, Y, r);
+		Y[l] = (void *)((uintptr_t)(V[l]) + i * s);
+		blockmix_salsa8(X[l], Y[l], r);
 
 		/* 4: X <-- H(X) */
 		/* 3: V_i <-- X */
-		X = (void *)((uintptr_t)(V) + (i + 1) * s);
-		blockmix_salsa8(Y, X, r);
-	}
+		X[l] = XY[l];
+		blockmix_salsa8(Y[l], X[l], r);
 
-	/* 4: X <-- H(X) */
-	/* 3: V_i <-- X */
-	Y = (void *)((uintptr_t)(V) + i * s);
-	blockmix_salsa8(X, Y, r);
+		Y[l] = (void *)((uintptr_t)(XY[l]) + s);
 
-	/* 4: X <-- H(X) */
-	/* 3: V_i <-- X */
-	X = XY;
-	blockmix_salsa8(Y, X, r);
-
-	X32 = XY;
-	Y = (void *)((uintptr_t)(XY) + s);
-
-	/* 7: j <-- Integerify(X) mod N */
-	j = integerify(X, r) & (N - 1);
+		/* 7: j <-- Integerify(X) mod N */
+		j[l] = integerify(X[l], r) & (N - 1);
+		if (n > 1)
+			PREFETCH_V(l)
+	}
 
 	/* 6: for i = 0 to N - 1 do */
 	for (i = 0; i < N; i += 2) {
-		__m128i * V_j = (void *)((uintptr_t)(V) + j * s);
+		for (l = 0; l < n; l++) {
+			__m128i * V_j = (void *)((uintptr_t)(V[l]) + j[l] * s);
+
+			/* 8: X <-- H(X \xor V_j) */
+			/* 7: j <-- Integerify(X) mod N */
+			j[l] = blockmix_salsa8_xor(X[l], V_j, Y[l], r) & (N - 1);
+			if (n > 1)
+				PREFETCH_V(l)
+		}
 
-		/* 8: X <-- H(X \xor V_j) */
-		/* 7: j <-- Integerify(X) mod N */
-		j = blockmix_salsa8_xor(X, V_j, Y, r) & (N - 1);
-		V_j = (void *)((uintptr_t)(V) + j * s);
+		for (l = 0; l < n; l++) {
+			__m128i * V_j = (void *)((uintptr_t)(V[l]) + j[l] * s);
 
-		/* 8: X <-- H(X \xor V_j) */
-		/* 7: j <-- Integerify(X) mod N */
-		j = blockmix_salsa8_xor(Y, V_j, X, r) & (N - 1);
+			/* 8: X <-- H(X \xor V_j) */
+			/* 7: j <-- Integerify(X) mod N */
+			j[l] = blockmix_salsa8_xor(Y[l], V_j, X[l], r) & (N - 1);
+			if (n > 1)
+				PREFETCH_V(l)
+		}
 	}
 
-	/* 10: B' <-- X */
-	for (k = 0; k < 2 * r; k++) {
-		for (i = 0; i < 16; i++) {
-			le32enc(&B[(k * 16 + (i * 5 % 16)) * 4],
-			    X32[k * 16 + i]);
+#undef PREFETCH_V
+
+	for (l = 0; l < n; l++) {
+		/* 10: B' <-- X */
+		X32 = XY[l];
+		for (k = 0; k < 2 * r; k++) {
+			for (i = 0; i < 16; i++) {
+				le32enc(&B[l][(k * 16 + (i * 5 % 16)) * 4],
+				    X32[k * 16 + i]);
+			}
 		}
 	}
 }
 
 /**
- * escrypt_kdf(local, passwd, passwdlen, salt, saltlen,
+ * escrypt_kdf_x(local, n, passwd, passwdlen, salt, saltlen,
  *     N, r, p, buf, buflen):
- * Compute scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], N, r,
- * p, buflen) and write the result into buf.  The parameters r, p, and buflen
- * must satisfy r * p < 2^30 and buflen <= (2^32 - 1) * 32.  The parameter N
- * must be a power of 2 greater than 1.
+ * Compute scrypt(passwd[l][0 .. passwdlen[l] - 1], salt[0 .. saltlen - 1],
+ * N, r, p, buflen) for the n (1 to ESCRYPT_MAX_X) candidates l, and write the
+ * results into buf[l].  The parameters r, p, and buflen must satisfy
+ * r * p < 2^30 and buflen <= (2^32 - 1) * 32.  The parameter N must be a
+ * power of 2 greater than 1.  The candidates' SMix are interleaved, which
+ * needs n times the memory of a single one.
  *
  * Return 0 on success; or -1 on error.
  */
 int
-escrypt_kdf(escrypt_local_t * local,
-    const uint8_t * passwd, size_t passwdlen,
+escrypt_kdf_x(escrypt_local_t * local, int n,
+    const uint8_t * const * passwd, const size_t * passwdlen,
     const uint8_t * salt, size_t saltlen,
     uint64_t N, uint32_t r, uint32_t p,
-    uint8_t * buf, size_t buflen)
+    uint8_t * const * buf, size_t buflen)
 {
 	size_t B_size, V_size, XY_size, need;
-	uint8_t * B;
-	uint32_t * V, * XY;
+	uint8_t * B[ESCRYPT_MAX_X], * Bi[ESCRYPT_MAX_X];
+	void * V[ESCRYPT_MAX_X], * XY[ESCRYPT_MAX_X];
 	uint32_t i;
+	int l;
 
 	/* Sanity-check parameters. */
+	if (n < 1 || n > ESCRYPT_MAX_X) {
+		errno = EINVAL;
+		return -1;
+	}
 #if SIZE_MAX > UINT32_MAX
 	if (buflen > (((uint64_t)(1) << 32) - 1) * 32) {
 		errno = EFBIG;
@@ -356,32 +400,60 @@ escrypt_kdf(escrypt_local_t * local,
 	}
 	XY_size = (size_t)256 * r + 64;
 	need += XY_size;
-	if (need < XY_size) {
+	if (need < XY_size || need > SIZE_MAX / n) {
 		errno = ENOMEM;
 		return -1;
 	}
-	if (local->size < need) {
+	if (local->size < need * n) {
 		if (free_region(local))
 			return -1;
-		if (!alloc_region(local, need))
+		if (!alloc_region(local, need * n))
 			return -1;
 	}
-	B = (uint8_t *)local->aligned;
-	V = (uint32_t *)((uint8_t *)B + B_size);
-	XY = (uint32_t *)((uint8_t *)V + V_size);
-
-	/* 1: (B_0 ... B_{p-1}) <-- PBKDF2(P, S, 1, p * MFLen) */
-	PBKDF2_SHA256(passwd, passwdlen, salt, saltlen, 1, B, B_size);
+	for (l = 0; l < n; l++) {
+		B[l] = (uint8_t *)local->aligned + need * l;
+		V[l] = (uint8_t *)B[l] + B_size;
+		XY[l] = (uint8_t *)V[l] + V_size;
+
+		/* 1: (B_0 ... B_{p-1}) <-- PBKDF2(P, S, 1, p * MFLen) */
+		PBKDF2_SHA256(passwd[l], passwdlen[l], salt, saltlen, 1,
+		    B[l], B_size);
+	}
 
 	/* 2: for i = 0 to p - 1 do */
 	for (i = 0; i < p; i++) {
 		/* 3: B_i <-- MF(B_i, N) */
-		smix(&B[(size_t)128 * i * r], r, N, V, XY);
+		for (l = 0; l < n; l++)
+			Bi[l] = &B[l][(size_t)128 * i * r];
+		smix_x(Bi, n, r, N, V, XY);
 	}
 
 	/* 5: DK <-- PBKDF2(P, B, 1, dkLen) */
-	PBKDF2_SHA256(passwd, passwdlen, B, B_size, 1, buf, buflen);
+	for (l = 0; l < n; l++)
+		PBKDF2_SHA256(passwd[l], passwdlen[l], B[l], B_size, 1,
+		    buf[l], buflen);
 
 	/* Success! */
 	return 0;
 }
+
+/**
+ * escrypt_kdf(local, passwd, passwdlen, salt, saltlen,
+ *     N, r, p, buf, buflen):
+ * Compute scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], N, r,
+ * p, buflen) and write the result into buf.  The parameters r, p, and buflen
+ * must satisfy r * p < 2^30 and buflen <= (2^32 - 1) * 32.  The parameter N
+ * must be a power of 2 greater than 1.
+ *
+ * Return 0 on success; or -1 on error.
+ */
+int
+escrypt_kdf(escrypt_local_t * local,
+    const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen,
+    uint64_t N, uint32_t r, uint32_t p,
+    uint8_t * buf, size_t buflen)
+{
+	return escrypt_kdf_x(local, 1, &passwd, &passwdlen, salt, saltlen,
+	    N, r, p, &buf, buflen);
+}
@@ -68,11 +68,29 @@ extern int escrypt_kdf(escrypt_local_t * __local,
     uint64_t __N, uint32_t __r, uint32_t __p,
     uint8_t * __buf, size_t __buflen);
 
+/*
+ * Most candidates escrypt_kdf_x() and escrypt_r_x() take at once.  Their SMix
+ * are interleaved, so that one candidate's random reads of V overlap with the
+ * BlockMix of the others.
+ */
+#define ESCRYPT_MAX_X 4
+
+extern int escrypt_kdf_x(escrypt_local_t * __local, int __n,
+    const uint8_t * const * __passwd, const size_t * __passwdlen,
+    const uint8_t * __salt, size_t __saltlen,
+    uint64_t __N, uint32_t __r, uint32_t __p,
+    uint8_t * const * __buf, size_t __buflen);
+
 extern uint8_t * escrypt_r(escrypt_local_t * __local,
     const uint8_t * __passwd, size_t __passwdlen,
     const uint8_t * __setting,
     uint8_t * __buf, size_t __buflen);
 
+extern int escrypt_r_x(escrypt_local_t * __local, int __n,
+    const uint8_t * const * __passwd, const size_t * __passwdlen,
+    const uint8_t * __setting,
+    uint8_t * const * __buf, size_t __buflen);
+
 extern uint8_t * escrypt(const uint8_t * __passwd, const uint8_t * __setting);
 
 extern uint8_t * escrypt_gensalt_r(
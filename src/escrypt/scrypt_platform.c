@@ -29,20 +29,65 @@
 #include "../memdbg.h"
 #include "../memory.h"
 
+#if defined(MAP_ANON) && !defined (MEMDBG_ON)
+#ifdef MAP_NOCORE
+#define MAP_FLAGS (MAP_ANON | MAP_PRIVATE | MAP_NOCORE)
+#else
+#define MAP_FLAGS (MAP_ANON | MAP_PRIVATE)
+#endif
+
+/*
+ * V is walked in random order, so with 4 KiB pages nearly every access of a
+ * large N is a TLB miss.  Regions at least this big get huge pages: explicit
+ * ones (MAP_HUGETLB) when the system has any reserved, else a mapping aligned
+ * to the huge page size and marked for transparent huge pages.
+ */
+#define HUGEPAGE_SIZE ((size_t)2 << 20)
+#endif
+
 static void *
 alloc_region(escrypt_region_t * region, size_t size)
 {
 	uint8_t * base, * aligned;
 #if defined(MAP_ANON) && !defined (MEMDBG_ON)
-	if ((base = mmap(NULL, size, PROT_READ | PROT_WRITE,
-#ifdef MAP_NOCORE
-	    MAP_ANON | MAP_PRIVATE | MAP_NOCORE,
-#else
-	    MAP_ANON | MAP_PRIVATE,
+	base = MAP_FAILED;
+	if (size >= HUGEPAGE_SIZE && size <= SIZE_MAX - HUGEPAGE_SIZE) {
+		size_t hsize = (size + HUGEPAGE_SIZE - 1) & ~(HUGEPAGE_SIZE - 1);
+#ifdef MAP_HUGETLB
+		base = mmap(NULL, hsize, PROT_READ | PROT_WRITE,
+		    MAP_FLAGS | MAP_HUGETLB, -1, 0);
+		if (base != MAP_FAILED) {
+			size = hsize;
+			aligned = base;
+		} else
 #endif
-	    -1, 0)) == MAP_FAILED)
-		base = NULL;
-	aligned = base;
+		if ((base = mmap(NULL, hsize + HUGEPAGE_SIZE,
+		    PROT_READ | PROT_WRITE, MAP_FLAGS, -1, 0)) != MAP_FAILED) {
+			aligned = base + HUGEPAGE_SIZE - 1;
+			aligned -= (uintptr_t)aligned & (HUGEPAGE_SIZE - 1);
+/*
+ * Give back the slack on both sides, so that what is left is exactly the
+ * usable hsize bytes: region->size is both what the callers may reuse and
+ * what free_region() unmaps.
+ */
+			if (aligned > base)
+				munmap(base, aligned - base);
+			if (base + HUGEPAGE_SIZE > aligned)
+				munmap(aligned + hsize,
+				    base + HUGEPAGE_SIZE - aligned);
+			base = aligned;
+			size = hsize;
+#ifdef MADV_HUGEPAGE
+			madvise(aligned, hsize, MADV_HUGEPAGE);
+#endif
+		}
+	}
+	if (base == MAP_FAILED) {
+		if ((base = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		    MAP_FLAGS, -1, 0)) == MAP_FAILED)
+			base = NULL;
+		aligned = base;
+	}
 #elif defined(HAVE_POSIX_MEMALIGN) && !defined (MEMDBG_ON)
 	if ((errno = posix_memalign(&base, 64, size)) != 0)
 		base = NULL;
@@ -0,0 +1,193 @@
+/*
+ * This software is hereby released to the general public under the
+ * following terms: Redistribution and use in source and binary forms,
+ * with or without modification, are permitted.
+ *
+ * Each worker process writes the output for the files it takes to a
+ * temporary file of its own and records where that output starts and ends
+ * in a shared array.  File numbers are handed out through a pipe, so a few
+ * huge archives don't hold up a worker's share of small ones.  When all the
+ * workers are done, we copy their outputs to stdout in the original order.
+ */
+
+#include "os.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#if (!AC_BUILT || HAVE_UNISTD_H) && !_MSC_VER
+#include <unistd.h>
+#endif
+
+#if OS_FORK && HAVE_MMAP
+#define FILEPOOL_FORK			1
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <signal.h>
+#else
+#define FILEPOOL_FORK			0
+#endif
+
+#include "jumbo.h"
+#include "misc.h"
+#include "memory.h"
+#include "filepool.h"
+#include "memdbg.h"
+
+int filepool_jobs(const char *arg)
+{
+	int jobs = atoi(arg);
+
+	if (jobs < 1 || jobs > 1024) {
+		fprintf(stderr, "Invalid number of jobs: %s\n", arg);
+		exit(EXIT_FAILURE);
+	}
+
+	return jobs;
+}
+
+#if FILEPOOL_FORK
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS			MAP_ANON
+#endif
+
+struct filepool_out {
+	int worker;
+	off_t start, end;
+};
+
+static void filepool_worker(int worker, int queue, char **names,
+	struct filepool_out *out, void (*process)(const char *name))
+{
+	int index;
+
+	while (read(queue, &index, sizeof(index)) == sizeof(index)) {
+		fflush(stdout);
+		out[index].start = lseek(1, 0, SEEK_CUR);
+		process(names[index]);
+		fflush(stdout);
+		out[index].end = lseek(1, 0, SEEK_CUR);
+		out[index].worker = worker;
+	}
+
+	_exit(EXIT_SUCCESS);
+}
+
+static void filepool_copy(FILE *from, off_t start, off_t end)
+{
+	char buf[0x10000];
+
+	if (jtr_fseek64(from, start, SEEK_SET))
+		pexit("fseek");
+
+	while (start < end) {
+		size_t len = end - start < sizeof(buf) ? end - start : sizeof(buf);
+
+		if (fread(buf, 1, len, from) != len)
+			pexit("fread");
+		if (fwrite(buf, 1, len, stdout) != len)
+			pexit("fwrite");
+		start += len;
+	}
+}
+
+void filepool_run(int count, char **names, int jobs,
+	void (*process)(const char *name))
+{
+	struct filepool_out *out;
+	FILE **tmp;
+	int queue[2], i, failed = 0;
+	void (*old_sigpipe)(int);
+
+	if (jobs > count)
+		jobs = count;
+	if (jobs < 2) {
+		for (i = 0; i < count; i++)
+			process(names[i]);
+		return;
+	}
+
+	out = mmap(NULL, count * sizeof(*out), PROT_READ | PROT_WRITE,
+	    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (out == MAP_FAILED)
+		pexit("mmap");
+	for (i = 0; i < count; i++)
+		out[i].worker = -1;
+
+	tmp = mem_alloc(jobs * sizeof(*tmp));
+	for (i = 0; i < jobs; i++)
+		if (!(tmp[i] = tmpfile()))
+			pexit("tmpfile");
+
+	if (pipe(queue))
+		pexit("pipe");
+
+	fflush(stdout);
+	fflush(stderr);
+
+	for (i = 0; i < jobs; i++) {
+		switch (fork()) {
+		case -1:
+			pexit("fork");
+
+		case 0:
+			close(queue[1]);
+			if (dup2(fileno(tmp[i]), 1) < 0)
+				pexit("dup2");
+			filepool_worker(i, queue[0], names, out, process);
+		}
+	}
+
+	close(queue[0]);
+/*
+ * Writes this small are atomic, and block until a worker is ready.  If all
+ * the workers are gone, we get EPIPE rather than being killed, and report
+ * the files left over below.
+ */
+	old_sigpipe = signal(SIGPIPE, SIG_IGN);
+	for (i = 0; i < count; i++)
+		if (write(queue[1], &i, sizeof(i)) != sizeof(i)) {
+			if (errno != EPIPE)
+				pexit("write");
+			failed = 1;
+			break;
+		}
+	close(queue[1]);
+	signal(SIGPIPE, old_sigpipe);
+
+	for (i = 0; i < jobs; i++) {
+		int status;
+
+		if (wait(&status) < 0)
+			pexit("wait");
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			failed = 1;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (out[i].worker < 0) {
+			fprintf(stderr, "! %s: not processed%s\n", names[i],
+			    failed ? " (worker died)" : "");
+			continue;
+		}
+		filepool_copy(tmp[out[i].worker], out[i].start, out[i].end);
+	}
+	fflush(stdout);
+
+	for (i = 0; i < jobs; i++)
+		fclose(tmp[i]);
+	MEM_FREE(tmp);
+	munmap(out, count * sizeof(*out));
+}
+#else
+void filepool_run(int count, char **names, int jobs,
+	void (*process)(const char *name))
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		process(names[i]);
+}
+#endif
@@ -0,0 +1,28 @@
+/*
+ * This software is hereby released to the general public under the
+ * following terms: Redistribution and use in source and binary forms,
+ * with or without modification, are permitted.
+ */
+
+/*
+ * Parallel processing of input files for the *2john tools.
+ */
+
+#ifndef _JOHN_FILEPOOL_H
+#define _JOHN_FILEPOOL_H
+
+/*
+ * Calls process() for each of the count file names, using up to jobs worker
+ * processes (when supported, otherwise one file after another).  Whatever
+ * process() writes to stdout is passed on in the order of the names, so the
+ * output is the same as with a plain loop.  Output to stderr is not ordered.
+ */
+extern void filepool_run(int count, char **names, int jobs,
+	void (*process)(const char *name));
+
+/*
+ * Parses the argument of a -j option, exits with an error if invalid.
+ */
+extern int filepool_jobs(const char *arg);
+
+#endif
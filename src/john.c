@@ -1165,6 +1165,11 @@ static void john_load(void)
 
 		ldr_init_database(&database, &options.loader);
 
+		if (options.test_load)
+			benchmark_load(&database);
+		else if (options.flags & FLG_TEST_GEN)
+			benchmark_generator(&database);
+		else
 		if ((current = options.passwd->head))
 		do {
 			ldr_load_pw_file(&database, current->data);
@@ -1211,6 +1216,9 @@ static void john_load(void)
 
 		ldr_fix_database(&database);
 
+		if (options.test_load)
+			benchmark_load_done();
+
 		if (!database.password_count) {
 			log_discard();
 			if (john_main_process)
@@ -1785,6 +1793,10 @@ static void john_done(void)
 			fprintf(stderr, "%s\n", msg);
 			exit_status = 1;
 		}
+		if (options.test_load && database.salts)
+			benchmark_load_report(&database);
+		if (options.flags & FLG_TEST_GEN)
+			benchmark_generator_report();
 		fmt_done(database.format);
 	}
 #if defined(HAVE_CUDA) || defined(HAVE_OPENCL)
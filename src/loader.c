@@ -14,10 +14,14 @@
 // needs to be above sys/stat.h for mingw, if -std=c99 used.
 #include "jumbo.h"
 #include <sys/stat.h>
+#define NEED_OS_FORK
 #include "os.h"
 #if (!AC_BUILT || HAVE_UNISTD_H) && !_MSC_VER
 #include <unistd.h>
 #endif
+#if OS_FORK
+#include <sys/wait.h>
+#endif
 #ifdef _MSC_VER
 #define S_ISDIR(a) ((a) & _S_IFDIR)
 #endif
@@ -73,6 +77,12 @@ static int ldr_fmt_salt_size;
  */
 #define RF_ALLOW_MISSING		1
 #define RF_ALLOW_DIR			2
+/* Only the lines starting in [read_range_start, read_range_end) */
+#define RF_RANGE			4
+
+#if OS_FORK
+static int64_t read_range_start, read_range_end;
+#endif
 
 /*
  * Fast "Strlen" for fields[f]
@@ -197,7 +207,24 @@ static void read_file(struct db_main *db, char *name, int flags,
 	}
 
 	dyna_salt_init(db->format);
-	while ((ex_size_line = fgetll(line_buf, sizeof(line_buf), file))) {
+#if OS_FORK
+	if ((flags & RF_RANGE) && read_range_start) {
+		/* Skip to the first line starting at or after the start */
+		if (jtr_fseek64(file, read_range_start - 1, SEEK_SET))
+			pexit("fseek");
+		if ((ex_size_line = fgetll(line_buf, sizeof(line_buf), file)) &&
+		    ex_size_line != line_buf)
+			MEM_FREE(ex_size_line);
+	}
+#endif
+	while (1) {
+#if OS_FORK
+		if ((flags & RF_RANGE) &&
+		    jtr_ftell64(file) >= read_range_end)
+			break;
+#endif
+		if (!(ex_size_line = fgetll(line_buf, sizeof(line_buf), file)))
+			break;
 		line = skip_bom(ex_size_line);
 
 		if (warn_enc) {
@@ -231,7 +258,7 @@ static void read_file(struct db_main *db, char *name, int flags,
 		check_abort(0);
 	}
 	if (name == options.activepot)
-		crk_pot_pos = jtr_ftell64(file);
+		crk_pot_mark(file);
 
 	if (ferror(file)) pexit("fgets");
 
@@ -262,6 +289,7 @@ void ldr_init_database(struct db_main *db, struct db_options *db_options)
 		db->options->flags |= DB_LOGIN;
 
 	db->salts = NULL;
+	db->salt_arena = NULL;
 
 	db->password_hash = NULL;
 	db->password_hash_func = NULL;
@@ -893,6 +921,247 @@ static struct list_main *ldr_init_words(char *login, char *gecos, char *home)
 	return words;
 }
 
+/*
+ * Formats without a source() method of their own get their ciphertexts kept
+ * packed in pw->source: a leading "$tag$" is stored once in ldr_source_tags[]
+ * and referred to by number, and the longest run of same-case hex digits is
+ * stored as bytes.  A "$NT$" line takes 20 bytes this way instead of 37.
+ *
+ * Layout: tag number (LDR_SOURCE_TAGS for none), length of the text before
+ * the hex run with 0x80 set for uppercase hex, that text, number of hex
+ * bytes, the hex bytes, and whatever follows as a NUL terminated string.
+ */
+#define LDR_SOURCE_TAGS			0xff
+#define LDR_SOURCE_TAG_LEN		32
+#define LDR_SOURCE_HEX_MIN		16
+
+static char *ldr_source_tags[LDR_SOURCE_TAGS];
+static unsigned char ldr_source_tag_lens[LDR_SOURCE_TAGS];
+static unsigned int ldr_source_tag_count, ldr_source_tag_last;
+
+/*
+ * --regen-lost-salts patches the stored source in place, so it needs it
+ * unpacked.
+ */
+static int ldr_packs_source(struct fmt_main *format)
+{
+	return format->methods.source == fmt_default_source &&
+		!options.regen_lost_salts;
+}
+
+static unsigned int ldr_source_tag(char *source, size_t *len)
+{
+	unsigned int tag;
+	char *end;
+
+	*len = 0;
+	if (*source != '$' || !(end = strchr(source + 1, '$')) ||
+	    end - source >= LDR_SOURCE_TAG_LEN)
+		return LDR_SOURCE_TAGS;
+	*len = end - source + 1;
+
+	tag = ldr_source_tag_last;
+	if (tag < ldr_source_tag_count && ldr_source_tag_lens[tag] == *len &&
+	    !memcmp(ldr_source_tags[tag], source, *len))
+		return tag;
+
+	for (tag = 0; tag < ldr_source_tag_count; tag++)
+		if (ldr_source_tag_lens[tag] == *len &&
+		    !memcmp(ldr_source_tags[tag], source, *len))
+			break;
+
+	if (tag == ldr_source_tag_count) {
+		if (tag == LDR_SOURCE_TAGS) {
+			*len = 0;
+			return tag;
+		}
+		ldr_source_tags[tag] = mem_alloc_copy(source, *len,
+			MEM_ALIGN_NONE);
+		ldr_source_tag_lens[tag] = *len;
+		ldr_source_tag_count++;
+	}
+
+	return ldr_source_tag_last = tag;
+}
+
+static char *ldr_pack_source(char *source)
+{
+	unsigned char *packed, *p;
+	size_t tag_len, pre, hex, pos, run, lower, upper, rest;
+	unsigned int tag;
+	int uc;
+
+	tag = ldr_source_tag(source, &tag_len);
+	source += tag_len;
+
+	pre = hex = uc = 0;
+	for (pos = 0; source[pos]; pos += run ? run : 1) {
+		for (lower = 0; atoi16l[ARCH_INDEX(source[pos + lower])] != 0x7F;
+		     lower++);
+		for (upper = 0; atoi16u[ARCH_INDEX(source[pos + upper])] != 0x7F;
+		     upper++);
+		run = lower > upper ? lower : upper;
+		if (run > hex) {
+			pre = pos;
+			uc = upper > lower;
+			hex = run;
+		}
+	}
+
+	hex &= ~(size_t)1;
+	if (hex > 0xff * 2)
+		hex = 0xff * 2;
+	if (hex < LDR_SOURCE_HEX_MIN || pre > 0x7f)
+		pre = hex = uc = 0;
+	rest = strlen(source + pre + hex);
+
+	p = packed = mem_alloc_tiny(3 + pre + hex / 2 + rest + 1,
+		MEM_ALIGN_NONE);
+	*p++ = tag;
+	*p++ = pre | (uc ? 0x80 : 0);
+	memcpy(p, source, pre);
+	p += pre;
+	source += pre;
+	*p++ = hex / 2;
+	for (pos = 0; pos < hex; pos += 2)
+		*p++ = atoi16[ARCH_INDEX(source[pos])] << 4 |
+			atoi16[ARCH_INDEX(source[pos + 1])];
+	memcpy(p, source + hex, rest + 1);
+
+	return (char*)packed;
+}
+
+char *ldr_pw_source(struct fmt_main *format, struct db_password *pw)
+{
+	static char *buf;
+	static size_t size;
+	unsigned char *p = (unsigned char*)pw->source;
+	const char *itoa;
+	size_t tag_len, pre, hex, rest, need;
+	char *q;
+
+	if (!ldr_packs_source(format))
+		return format->methods.source(pw->source, pw->binary);
+
+	tag_len = p[0] < ldr_source_tag_count ? ldr_source_tag_lens[p[0]] : 0;
+	pre = p[1] & 0x7f;
+	itoa = (p[1] & 0x80) ? itoa16u : itoa16;
+	hex = p[2 + pre];
+	rest = strlen((char*)&p[3 + pre + hex]);
+
+	need = tag_len + pre + hex * 2 + rest + 1;
+	if (need > size) {
+		MEM_FREE(buf);
+		size = need < LINE_BUFFER_SIZE ? LINE_BUFFER_SIZE : need;
+		buf = mem_alloc(size);
+	}
+
+	q = buf;
+	if (tag_len) {
+		memcpy(q, ldr_source_tags[p[0]], tag_len);
+		q += tag_len;
+	}
+	memcpy(q, &p[2], pre);
+	q += pre;
+	p += 3 + pre;
+	while (hex--) {
+		*q++ = itoa[*p >> 4];
+		*q++ = itoa[*p++ & 0xf];
+	}
+	memcpy(q, p, rest + 1);
+
+	return buf;
+}
+
+/*
+ * Salts are kept in slots of a db_salt followed by the format's salt blob.
+ * Chunk n holds SALT_ARENA_SLOTS << n of them, so a slot number maps to a
+ * fixed address and ldr_pack_salts() can sort the slots in place.
+ */
+#define SALT_ARENA_CHUNKS		32
+
+struct db_salt_arena {
+	size_t slot_size, blob_offset;
+	unsigned int count, size;
+	int chunks;
+	char *chunk[SALT_ARENA_CHUNKS];
+};
+
+static struct db_salt *ldr_salt_slot(struct db_salt_arena *arena,
+	unsigned int n)
+{
+	int chunk = 0;
+
+	while (n >= (size_t)SALT_ARENA_SLOTS << chunk)
+		n -= SALT_ARENA_SLOTS << chunk++;
+
+	return (struct db_salt *)(arena->chunk[chunk] + n * arena->slot_size);
+}
+
+static unsigned int ldr_salt_slot_number(struct db_salt_arena *arena,
+	struct db_salt *salt)
+{
+	unsigned int base = 0;
+	int chunk;
+
+	for (chunk = 0; chunk < arena->chunks; chunk++) {
+		size_t slots = (size_t)SALT_ARENA_SLOTS << chunk;
+
+		if ((char *)salt >= arena->chunk[chunk] &&
+		    (char *)salt < arena->chunk[chunk] +
+		    slots * arena->slot_size)
+			return base + ((char *)salt - arena->chunk[chunk]) /
+				arena->slot_size;
+		base += slots;
+	}
+
+	return UINT_MAX; /* can't happen */
+}
+
+static struct db_salt *ldr_new_salt(struct db_main *db,
+	struct fmt_main *format, void *salt)
+{
+	struct db_salt_arena *arena = db->salt_arena;
+	struct db_salt *new;
+	size_t align;
+
+	if (mem_saving_level) {
+		new = mem_alloc_tiny(db->salt_size, MEM_ALIGN_WORD);
+		new->salt = mem_alloc_copy(salt, format->params.salt_size,
+			format->params.salt_align);
+		return new;
+	}
+
+	align = format->params.salt_align;
+	if (align < MEM_ALIGN_WORD)
+		align = MEM_ALIGN_WORD;
+
+	if (!arena) {
+		arena = db->salt_arena = mem_alloc_tiny(sizeof(*arena),
+			MEM_ALIGN_WORD);
+		memset(arena, 0, sizeof(*arena));
+		arena->blob_offset = (db->salt_size + align - 1) & ~(align - 1);
+		arena->slot_size = (arena->blob_offset +
+			format->params.salt_size + align - 1) & ~(align - 1);
+	}
+
+	if (arena->count == arena->size) {
+		size_t slots = (size_t)SALT_ARENA_SLOTS << arena->chunks;
+
+		if (align < MEM_ALIGN_CACHE)
+			align = MEM_ALIGN_CACHE;
+		arena->chunk[arena->chunks++] =
+			mem_alloc_tiny(slots * arena->slot_size, align);
+		arena->size += slots;
+	}
+
+	new = ldr_salt_slot(arena, arena->count++);
+	new->salt = memcpy((char *)new + arena->blob_offset, salt,
+		format->params.salt_size);
+
+	return new;
+}
+
 #ifdef HAVE_FUZZ
 void ldr_load_pw_line(struct db_main *db, char *line)
 #else
@@ -972,8 +1241,8 @@ static void ldr_load_pw_line(struct db_main *db, char *line)
 			do {
 				if (!memcmp(binary, current_pw->binary,
 				    format->params.binary_size) &&
-				    !strcmp(piece, format->methods.source(
-				    current_pw->source, current_pw->binary))) {
+				    !strcmp(piece,
+				    ldr_pw_source(format, current_pw))) {
 					db->options->flags |= DB_NODUP;
 					break;
 				}
@@ -1017,13 +1286,9 @@ static void ldr_load_pw_line(struct db_main *db, char *line)
 		if (!current_salt) {
 			last_salt = db->salt_hash[salt_hash];
 			current_salt = db->salt_hash[salt_hash] =
-				mem_alloc_tiny(db->salt_size, MEM_ALIGN_WORD);
+				ldr_new_salt(db, format, salt);
 			current_salt->next = last_salt;
 
-			current_salt->salt = mem_alloc_copy(salt,
-				format->params.salt_size,
-				format->params.salt_align);
-
 			for (i = 0; i < FMT_TUNABLE_COSTS && format->methods.tunable_cost_value[i] != NULL; ++i)
 				current_salt->cost[i] = format->methods.tunable_cost_value[i](current_salt->salt);
 
@@ -1075,7 +1340,8 @@ static void ldr_load_pw_line(struct db_main *db, char *line)
 				format->params.binary_align);
 
 		if (format->methods.source == fmt_default_source)
-			current_pw->source = str_alloc_copy(piece);
+			current_pw->source = ldr_packs_source(format) ?
+				ldr_pack_source(piece) : str_alloc_copy(piece);
 
 		if (db->options->flags & DB_WORDS) {
 			if (!words)
@@ -1143,7 +1409,7 @@ static void ldr_load_pot_line(struct db_main *db, char *line)
 		if (memcmp(binary, current->binary, format->params.binary_size))
 			continue;
 		if (ldr_pot_source_cmp(ciphertext,
-		    format->methods.source(current->source, current->binary)))
+		    ldr_pw_source(format, current)))
 			continue;
 		current->binary = NULL; /* mark for removal */
 		need_removal = 1;
@@ -1238,6 +1504,97 @@ void ldr_free_test_db(struct db_main *db)
 	}
 }
 
+/*
+ * Finds the longest run of hex digits (at least 8) in a ciphertext, which
+ * in almost all formats is (part of) the hash itself.
+ */
+static int ldr_synth_run(char *ciphertext, int *len)
+{
+	int pos = -1, i = 0;
+
+	*len = 7;
+	while (ciphertext[i]) {
+		int j = i;
+
+		while (isxdigit(ARCH_INDEX(ciphertext[j])))
+			j++;
+		if (j - i >= *len) {
+			pos = i;
+			*len = j - i;
+		}
+		i = j + !!ciphertext[j];
+	}
+	return pos;
+}
+
+static void ldr_synth_put(char *dst, unsigned int n, int upper)
+{
+	const char *itoa = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	int i;
+
+	/* Spread consecutive numbers over the whole range */
+	n *= 0x9e3779b1;
+	for (i = 0; i < 8; i++, n <<= 4)
+		dst[i] = itoa[n >> 28];
+}
+
+void ldr_load_synth(struct db_main *db, unsigned int count)
+{
+	struct fmt_main *format = db->format ? db->format : fmt_list;
+	struct fmt_tests *current;
+	char line[LINE_BUFFER_SIZE], *ciphertext = NULL;
+	int pos = -1, len, upper = 0, prefix;
+	unsigned int n;
+
+	db->format = format;
+
+	if ((current = format->params.tests))
+	for (; current->ciphertext; current++) {
+		char *fields[10], *prepared;
+		int i;
+
+		ciphertext = current->fields[1] ?
+			current->fields[1] : current->ciphertext;
+		if (strlen(ciphertext) > LINE_BUFFER_SIZE - 32 ||
+		    strchr(ciphertext, db->options->field_sep_char) ||
+		    (pos = ldr_synth_run(ciphertext, &len)) < 0)
+			continue;
+
+		ciphertext = str_alloc_copy(ciphertext);
+		for (i = pos; i < pos + len; i++)
+			if (ciphertext[i] >= 'A' && ciphertext[i] <= 'F')
+				upper = 1;
+		ldr_synth_put(&ciphertext[pos], 0, upper);
+
+		/* We'll load it as "login:ciphertext" so that's what we try */
+		fields[0] = "synth0";
+		fields[1] = ciphertext;
+		for (i = 2; i < 10; i++)
+			fields[i] = "";
+		prepared = format->methods.prepare(fields, format);
+		if (prepared && format->methods.valid(prepared, format) == 1)
+			break;
+		pos = -1;
+		upper = 0;
+	}
+
+	if (pos < 0) {
+		if (john_main_process)
+			fprintf(stderr, "Can't synthesize hashes for the %s "
+			        "format (no hex hash in its test vectors)\n",
+			        format->params.label);
+		error();
+	}
+
+	for (n = 0; n < count; n++) {
+		prefix = sprintf(line, "synth%u%c", n,
+		                 db->options->field_sep_char);
+		strcpy(&line[prefix], ciphertext);
+		ldr_synth_put(&line[prefix + pos], n, upper);
+		ldr_load_pw_line(db, line);
+	}
+}
+
 void ldr_load_pot_file(struct db_main *db, char *name)
 {
 	if (db->format && !(db->format->params.flags & FMT_NOT_EXACT)) {
@@ -1449,6 +1806,68 @@ static void ldr_sort_salts(struct db_main *db)
 #endif
 }
 
+/*
+ * Once salts are in their final order, sort their arena slots into that same
+ * order, so that the cracker walks memory sequentially rather than hopping
+ * around in load order.  The slots are swapped in place, so this costs no
+ * memory beyond a slot number per loaded salt while it runs.  For dyna_salt
+ * formats the blob is only the pointer: the structure behind it belongs to
+ * the format, we don't know its size, and it stays where it is (the cracker
+ * prefetches it instead).
+ */
+static void ldr_pack_salts(struct db_main *db)
+{
+	struct db_salt_arena *arena = db->salt_arena;
+	struct db_salt *s, *next;
+	unsigned int *dest, n, i;
+	char *tmp;
+
+	if (!arena || db->salt_count < 2)
+		return;
+
+	/* Removed salts leave their slots behind, these stay at UINT_MAX */
+	dest = mem_alloc(arena->count * sizeof(*dest));
+	memset(dest, 0xff, arena->count * sizeof(*dest));
+	for (s = db->salts, i = 0; s; s = s->next, i++)
+		dest[ldr_salt_slot_number(arena, s)] = i;
+
+	tmp = mem_alloc(arena->slot_size);
+	for (n = 0; n < arena->count; n++)
+	while ((i = dest[n]) != UINT_MAX && i != n) {
+		char *x = (char *)ldr_salt_slot(arena, n);
+		char *y = (char *)ldr_salt_slot(arena, i);
+
+		memcpy(tmp, x, arena->slot_size);
+		memcpy(x, y, arena->slot_size);
+		memcpy(y, tmp, arena->slot_size);
+		dest[n] = dest[i];
+		dest[i] = i;
+	}
+	MEM_FREE(tmp);
+	MEM_FREE(dest);
+
+	if (db->salt_hash)
+		memset(db->salt_hash, 0,
+		       SALT_HASH_SIZE * sizeof(struct db_salt *));
+
+	db->salts = next = ldr_salt_slot(arena, 0);
+	for (i = 1; i <= (unsigned int)db->salt_count; i++) {
+		s = next;
+		next = i < (unsigned int)db->salt_count ?
+			ldr_salt_slot(arena, i) : NULL;
+		s->next = next;
+		s->salt = (char *)s + arena->blob_offset;
+		s->hash = &s->list;
+
+		if (db->salt_hash) {
+			int hash = db->format->methods.salt_hash(s->salt);
+
+			if (!db->salt_hash[hash])
+				db->salt_hash[hash] = s;
+		}
+	}
+}
+
 /*
  * Emit the output for --show=left.
  */
@@ -1456,7 +1875,7 @@ static void ldr_show_left(struct db_main *db, struct db_password *pw)
 {
 	char uid_sep[2] = { 0 };
 	char *uid_out = "";
-	char *pw_source = db->format->methods.source(pw->source, pw->binary);
+	char *pw_source = ldr_pw_source(db->format, pw);
 	char *login = (db->options->flags & DB_LOGIN) ? pw->login : "?";
 
 #ifndef DYNAMIC_DISABLED
@@ -1752,6 +2171,7 @@ void ldr_fix_database(struct db_main *db)
 		ldr_cost_ranges(db);
 	}
 	ldr_sort_salts(db);
+	ldr_pack_salts(db);
 	ldr_init_hash(db);
 
 	ldr_init_sqid(db);
@@ -2082,7 +2502,101 @@ free_and_return:
 	MEM_FREE(utf8login);
 }
 
+#if OS_FORK
+/*
+ * --show with --fork=N: each child takes a slice of the password file, from
+ * line boundary to line boundary, and writes its report to a temporary file.
+ * The pot file was read before forking, so all children share the cracked
+ * hash table.  The parent copies the reports to stdout in order and sums the
+ * counts, so the output is the same as without --fork.
+ */
+static int ldr_show_pw_file_fork(struct db_main *db, char *name)
+{
+	struct stat file_stat;
+	FILE **out;
+	int (*fds)[2];
+	pid_t *pids;
+	int i, n = options.fork;
+	int guess_count = db->guess_count, password_count = db->password_count;
+	char buf[LINE_BUFFER_SIZE];
+	size_t len;
+
+	if (stat(path_expand(name), &file_stat) ||
+	    !S_ISREG(file_stat.st_mode) ||
+	    file_stat.st_size < (int64_t)n * LINE_BUFFER_SIZE)
+		return 0;
+
+	out = mem_alloc(n * sizeof(*out));
+	fds = mem_alloc(n * sizeof(*fds));
+	pids = mem_alloc(n * sizeof(*pids));
+
+	fflush(stdout);
+	for (i = 0; i < n; i++) {
+		if (!(out[i] = tmpfile()))
+			pexit("tmpfile");
+		if (pipe(fds[i]))
+			pexit("pipe");
+
+		switch ((pids[i] = fork())) {
+		case -1:
+			pexit("fork");
+
+		case 0:
+			john_main_process = 0;
+			close(fds[i][0]);
+			if (dup2(fileno(out[i]), fileno(stdout)) < 0)
+				pexit("dup2");
+			read_range_start = file_stat.st_size * i / n;
+			read_range_end = file_stat.st_size * (i + 1) / n;
+			read_file(db, name, RF_ALLOW_DIR | RF_RANGE,
+			          ldr_show_pw_line);
+			fflush(stdout);
+			if (write_loop(fds[i][1], (char *)&db->guess_count,
+			               sizeof(db->guess_count)) !=
+			    sizeof(db->guess_count) ||
+			    write_loop(fds[i][1], (char *)&db->password_count,
+			               sizeof(db->password_count)) !=
+			    sizeof(db->password_count))
+				pexit("write");
+			_exit(0);
+		}
+		close(fds[i][1]);
+	}
+
+	for (i = 0; i < n; i++) {
+		int status, counts[2];
+
+		if (waitpid(pids[i], &status, 0) != pids[i])
+			pexit("waitpid");
+		if (!WIFEXITED(status) || WEXITSTATUS(status) ||
+		    read(fds[i][0], counts, sizeof(counts)) != sizeof(counts)) {
+			fprintf(stderr, "--show child %d failed\n", i + 1);
+			error();
+		}
+		close(fds[i][0]);
+		db->guess_count += counts[0] - guess_count;
+		db->password_count += counts[1] - password_count;
+
+		rewind(out[i]);
+		while ((len = fread(buf, 1, sizeof(buf), out[i])))
+			fwrite(buf, 1, len, stdout);
+		fclose(out[i]);
+	}
+
+	MEM_FREE(pids);
+	MEM_FREE(fds);
+	MEM_FREE(out);
+	return 1;
+}
+#endif
+
 void ldr_show_pw_file(struct db_main *db, char *name)
 {
+#if OS_FORK
+	if (options.fork && (options.flags & FLG_SHOW_CHK) &&
+	    !(db->options->flags & DB_PLAINTEXTS) &&
+	    ldr_show_pw_file_fork(db, name))
+		return;
+#endif
 	read_file(db, name, RF_ALLOW_DIR, ldr_show_pw_line);
 }
@@ -53,21 +53,20 @@ struct db_password {
  * Buffered keys hash table entry.
  */
 struct db_keys_hash_entry {
-/* Index of next key with the same hash, or -1 if none */
+/* Index of next key with the same hash, or -1 if none.  The key itself is at
+ * buffer[index * plaintext_length]. */
 	short next;
-
-/* Byte offset of this key in the buffer */
-	unsigned short offset;
 };
 
 /*
  * Buffered keys hash.
  */
 struct db_keys_hash {
-/* The hash table, maps to indices for the list below; -1 means empty bucket */
-	short hash[SINGLE_HASH_SIZE];
+/* The hash table, maps to indices for the list below; -1 means empty bucket.
+ * Sized by single.c to the buffered key count, at least SINGLE_HASH_SIZE. */
+	short *hash;
 
-/* List of keys with the same hash, allocated as min_keys_per_crypt entries */
+/* List of keys with the same hash, one entry per buffered key */
 	struct db_keys_hash_entry list[1];
 };
 
@@ -99,7 +98,7 @@ struct db_keys {
 /* Number of recursive calls for this salt */
 	int lock;
 
-/* The keys, allocated as (plaintext_length * min_keys_per_crypt) bytes */
+/* The keys, allocated as (plaintext_length * buffered key count) bytes */
 	char buffer[1];
 };
 
@@ -233,6 +232,9 @@ struct db_main {
 /* Salt list */
 	struct db_salt *salts;
 
+/* Storage for the salts, NULL if they're allocated one by one */
+	struct db_salt_arena *salt_arena;
+
 /* Salt and password hash tables, used while loading */
 	struct db_salt **salt_hash;
 	struct db_password **password_hash;
@@ -285,6 +287,13 @@ extern void ldr_load_pw_line(struct db_main *db, char *line);
  */
 extern void ldr_load_pw_file(struct db_main *db, char *name);
 
+/*
+ * Loads count made-up hashes for db->format, or if that's not set for the
+ * first registered format, into the database (--test-load). They're
+ * derived from the format's test vectors.
+ */
+extern void ldr_load_synth(struct db_main *db, unsigned int count);
+
 /*
  * Removes passwords cracked in previous sessions from the database.
  */
@@ -317,6 +326,13 @@ extern void ldr_show_pot_file(struct db_main *db, char *name);
  */
 extern void ldr_show_pw_file(struct db_main *db, char *name);
 
+/*
+ * Returns the ciphertext of a loaded hash, as the format's source() method
+ * would, in a buffer that is reused by the next call.  Always use this rather
+ * than pw->source, which may be packed.
+ */
+extern char *ldr_pw_source(struct fmt_main *format, struct db_password *pw);
+
 /* Compare a possibly truncated pot source with a full one */
 extern int ldr_pot_source_cmp(const char *pot_entry, const char *full_source);
 
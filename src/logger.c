@@ -159,7 +159,7 @@ static void log_file_flush(struct log_file *f)
 	f->ptr = f->buffer;
 
 	if (f == &pot && pos_b4 == crk_pot_pos)
-		crk_pot_pos += count;
+		crk_pot_wrote(f->buffer, count);
 
 #if OS_FLOCK || FCNTL_LOCKS
 #ifdef LOCK_DEBUG
@@ -71,6 +71,9 @@ john_register_one(&fmt_mscash2);
 #include "simd-intrinsics.h"
 #include "loader.h"
 #include "mscash_common.h"
+#ifdef SIMD_COEF_32
+#include "pbkdf2_hmac_sha1.h"
+#endif
 
 #if defined (_OPENMP)
 #include <omp.h>
@@ -95,14 +98,7 @@ static unsigned iteration_cnt =	(ITERATIONS); /* this will get changed at runtim
 #define ALGORITHM_NAME			"PBKDF2-SHA1 " SHA1_ALGORITHM_NAME
 
 #ifdef SIMD_COEF_32
-#define MS_NUM_KEYS			(SIMD_COEF_32*SIMD_PARA_SHA1)
-// Ok, now we have our MMX/SSE2/intr buffer.
-// this version works properly for MMX, SSE2 (.S) and SSE2 intrinsic.
-#define GETPOS(i, index)	( (index&(SIMD_COEF_32-1))*4 + ((i)&(0xffffffff-3) )*SIMD_COEF_32 + (3-((i)&3)) + (unsigned int)index/SIMD_COEF_32*SHA_BUF_SIZ*SIMD_COEF_32*4 ) //for endianity conversion
-static unsigned char (*sse_hash1);
-static unsigned char (*sse_crypt1);
-static unsigned char (*sse_crypt2);
-
+#define MS_NUM_KEYS			SSE_GROUP_SZ_SHA1
 #else
 # define MS_NUM_KEYS			1
 #endif
@@ -137,38 +133,12 @@ static void init(struct fmt_main *self)
 	                     HASH_LEN);
 	crypt_out = mem_calloc(self->params.max_keys_per_crypt,
 	                       BINARY_SIZE);
-#if defined (SIMD_COEF_32)
-	sse_hash1 = mem_calloc_align(self->params.max_keys_per_crypt,
-	                             sizeof(*sse_hash1)*SHA_BUF_SIZ*4,
-	                             MEM_ALIGN_SIMD);
-	sse_crypt1 = mem_calloc_align(self->params.max_keys_per_crypt,
-	                              sizeof(*sse_crypt1) * 20, MEM_ALIGN_SIMD);
-	sse_crypt2 = mem_calloc_align(self->params.max_keys_per_crypt,
-	                              sizeof(*sse_crypt2) * 20, MEM_ALIGN_SIMD);
-	{
-		int index;
-		for (index = 0; index < self->params.max_keys_per_crypt; ++index) {
-			// set the length of all hash1 SSE buffer to 64+20 * 8 bits
-			// The 64 is for the ipad/opad, the 20 is for the length of the SHA1 buffer that also gets into each crypt
-			// this works for SSEi
-			((unsigned int *)sse_hash1)[15*SIMD_COEF_32 + (index&(SIMD_COEF_32-1)) + (unsigned int)index/SIMD_COEF_32*SHA_BUF_SIZ*SIMD_COEF_32] = (84<<3); // all encrypts are 64+20 bytes.
-			sse_hash1[GETPOS(20,index)] = 0x80;
-		}
-	}
-	// From this point on, we ONLY touch the first 20 bytes (* SIMD_COEF_32) of each buffer 'block'.  If !SHA_PARA', then only the first
-	// block is written to after this, if there are more that one SHA_PARA, then the start of each para block will be updated inside the inner loop.
-#endif
 
 	mscash2_adjust_tests(options.target_enc, PLAINTEXT_LENGTH, MAX_SALT_LEN);
 }
 
 static void done(void)
 {
-#ifdef SIMD_COEF_32
-	MEM_FREE(sse_crypt2);
-	MEM_FREE(sse_crypt1);
-	MEM_FREE(sse_hash1);
-#endif
 	MEM_FREE(crypt_out);
 	MEM_FREE(md4hash);
 	MEM_FREE(key);
@@ -250,9 +220,6 @@ static void *get_binary(char *ciphertext)
 #endif
 		out[i] = temp;
 	}
-#ifdef SIMD_COEF_32
-	alter_endianity(out, BINARY_SIZE);
-#endif
 	return out;
 }
 
@@ -397,88 +364,24 @@ static int salt_hash(void *salt)
 
 
 #ifdef SIMD_COEF_32
-// NOTE, in the end, this block will move above the pbkdf2() function, and the #else and #endif wrapping that function will be
-// uncommented. Thus, if built for SSE2 (mmx, or intrisic), we get this function. Otherwise we get the pbkdf2() function which
-// uses OpenSSL.  However to get the 'layout' right, The code here will walk through the array buffer, calling the pbkdf2
-// function.
+/*
+ * The shared SIMD PBKDF2 engine keeps every lane's ipad/opad state resident
+ * for all iterations.  The DCC1 hash is the HMAC key and we only need the
+ * first 16 bytes of the first output block.
+ */
 static void pbkdf2_sse2(int t)
 {
-	// Thread safe, t is our thread number.
-	// All indexes into buffers are offset by (t * MS_NUM_KEYS * (size))
-	SHA_CTX ctx1, ctx2;
-	unsigned int ipad[SHA_LBLOCK], opad[SHA_LBLOCK];
-	unsigned int tmp_hash[SHA_DIGEST_LENGTH/4];
-	unsigned int i, j, k, *i1, *i2, *o1, *t_crypt;
-	unsigned char *t_sse_crypt1, *t_sse_crypt2, *t_sse_hash1;
-
-	memset(&ipad[4], 0x36, SHA_CBLOCK-16);
-	memset(&opad[4], 0x5C, SHA_CBLOCK-16);
-
-
-	// All pointers get their offset for this thread here. No further offsetting below.
-	t_crypt = &crypt_out[t * MS_NUM_KEYS * 4];
-	t_sse_crypt1 = &sse_crypt1[t * MS_NUM_KEYS * 20];
-	t_sse_crypt2 = &sse_crypt2[t * MS_NUM_KEYS * 20];
-	t_sse_hash1 = &sse_hash1[t * MS_NUM_KEYS * SHA_BUF_SIZ * 4];
-	i1 = (unsigned int*)t_sse_crypt1;
-	i2 = (unsigned int*)t_sse_crypt2;
-	o1 = (unsigned int*)t_sse_hash1;
-
-	for(k = 0; k < MS_NUM_KEYS; ++k)
-	{
-		for(i = 0;i < 4;i++) {
-			ipad[i] = t_crypt[k*4+i]^0x36363636;
-			opad[i] = t_crypt[k*4+i]^0x5C5C5C5C;
-		}
-
-		SHA1_Init(&ctx1);
-		SHA1_Init(&ctx2);
-
-		SHA1_Update(&ctx1,ipad,SHA_CBLOCK);
-		SHA1_Update(&ctx2,opad,SHA_CBLOCK);
-
-		// we memcopy from flat into SIMD_COEF_32 output buffer's (our 'temp' ctx buffer).
-		// This data will NOT need to be BE swapped (it already IS BE swapped).
-		i1[(k/SIMD_COEF_32)*SIMD_COEF_32*5+(k&(SIMD_COEF_32-1))]               = ctx1.h0;
-		i1[(k/SIMD_COEF_32)*SIMD_COEF_32*5+(k&(SIMD_COEF_32-1))+SIMD_COEF_32]      = ctx1.h1;
-		i1[(k/SIMD_COEF_32)*SIMD_COEF_32*5+(k&(SIMD_COEF_32-1))+(SIMD_COEF_32<<1)] = ctx1.h2;
-		i1[(k/SIMD_COEF_32)*SIMD_COEF_32*5+(k&(SIMD_COEF_32-1))+SIMD_COEF_32*3]    = ctx1.h3;
-		i1[(k/SIMD_COEF_32)*SIMD_COEF_32*5+(k&(SIMD_COEF_32-1))+(SIMD_COEF_32<<2)] = ctx1.h4;
-
-		i2[(k/SIMD_COEF_32)*SIMD_COEF_32*5+(k&(SIMD_COEF_32-1))]               = ctx2.h0;
-		i2[(k/SIMD_COEF_32)*SIMD_COEF_32*5+(k&(SIMD_COEF_32-1))+SIMD_COEF_32]      = ctx2.h1;
-		i2[(k/SIMD_COEF_32)*SIMD_COEF_32*5+(k&(SIMD_COEF_32-1))+(SIMD_COEF_32<<1)] = ctx2.h2;
-		i2[(k/SIMD_COEF_32)*SIMD_COEF_32*5+(k&(SIMD_COEF_32-1))+SIMD_COEF_32*3]    = ctx2.h3;
-		i2[(k/SIMD_COEF_32)*SIMD_COEF_32*5+(k&(SIMD_COEF_32-1))+(SIMD_COEF_32<<2)] = ctx2.h4;
-
-		SHA1_Update(&ctx1,salt_buffer,salt_len);
-		SHA1_Update(&ctx1,"\x0\x0\x0\x1",4);
-		SHA1_Final((unsigned char*)tmp_hash,&ctx1);
-
-		SHA1_Update(&ctx2,(unsigned char*)tmp_hash,SHA_DIGEST_LENGTH);
-		SHA1_Final((unsigned char*)tmp_hash,&ctx2);
-
-		// now convert this from flat into SIMD_COEF_32 buffers.
-		// Also, perform the 'first' ^= into the crypt buffer.  NOTE, we are doing that in BE format
-		// so we will need to 'undo' that in the end.
-		o1[(k/SIMD_COEF_32)*SIMD_COEF_32*SHA_BUF_SIZ+(k&(SIMD_COEF_32-1))]                = t_crypt[k*4+0] = ctx2.h0;
-		o1[(k/SIMD_COEF_32)*SIMD_COEF_32*SHA_BUF_SIZ+(k&(SIMD_COEF_32-1))+SIMD_COEF_32]       = t_crypt[k*4+1] = ctx2.h1;
-		o1[(k/SIMD_COEF_32)*SIMD_COEF_32*SHA_BUF_SIZ+(k&(SIMD_COEF_32-1))+(SIMD_COEF_32<<1)]  = t_crypt[k*4+2] = ctx2.h2;
-		o1[(k/SIMD_COEF_32)*SIMD_COEF_32*SHA_BUF_SIZ+(k&(SIMD_COEF_32-1))+SIMD_COEF_32*3]     = t_crypt[k*4+3] = ctx2.h3;
-		o1[(k/SIMD_COEF_32)*SIMD_COEF_32*SHA_BUF_SIZ+(k&(SIMD_COEF_32-1))+(SIMD_COEF_32<<2)]                   = ctx2.h4;
-	}
-
-	for(i = 1; i < iteration_cnt; i++)
-	{
-		SIMDSHA1body((unsigned int*)t_sse_hash1, (unsigned int*)t_sse_hash1, (unsigned int*)t_sse_crypt1, SSEi_MIXED_IN|SSEi_RELOAD|SSEi_OUTPUT_AS_INP_FMT);
-		SIMDSHA1body((unsigned int*)t_sse_hash1, (unsigned int*)t_sse_hash1, (unsigned int*)t_sse_crypt2, SSEi_MIXED_IN|SSEi_RELOAD|SSEi_OUTPUT_AS_INP_FMT);
-		// only xor first 16 bytes, since that is ALL this format uses
-		for (k = 0; k < MS_NUM_KEYS; k++) {
-			unsigned *p = &((unsigned int*)t_sse_hash1)[k/SIMD_COEF_32*SHA_BUF_SIZ*SIMD_COEF_32 + (k&(SIMD_COEF_32-1))];
-			for(j = 0; j < 4; j++)
-				t_crypt[k*4+j] ^= p[(j*SIMD_COEF_32)];
-		}
+	int lens[MS_NUM_KEYS], i;
+	const unsigned char *pin[MS_NUM_KEYS];
+	unsigned char *pout[MS_NUM_KEYS];
+
+	for (i = 0; i < MS_NUM_KEYS; ++i) {
+		lens[i] = 16;
+		pin[i] = (unsigned char*)&crypt_out[(t * MS_NUM_KEYS + i) * 4];
+		pout[i] = (unsigned char*)&crypt_out[(t * MS_NUM_KEYS + i) * 4];
 	}
+	pbkdf2_sha1_sse(pin, lens, salt_buffer, salt_len, iteration_cnt,
+	                pout, 16, 0);
 }
 
 #else
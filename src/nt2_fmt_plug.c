@@ -324,6 +324,36 @@ static void *get_binary(char *ciphertext)
 	return out;
 }
 
+#if SIMD_COEF_32 && ARCH_LITTLE_ENDIAN
+/*
+ * Four 8-bit characters at a time into the vector key buffer, as two words
+ * of two UCS-2 characters each.  Stops at a NUL, at any byte with a bit of
+ * 'hibits' set (0x80808080 when only ASCII maps to itself) and short of the
+ * last pair, leaving termination to the per-character code of the caller.
+ */
+static MAYBE_INLINE const unsigned char *set_key_fast(const unsigned char *key,
+	unsigned int **keybuf_word, unsigned int *len, unsigned int hibits)
+{
+	unsigned int *word = *keybuf_word;
+	unsigned int l = *len;
+	uint32_t v;
+
+	while (l + 4 < PLAINTEXT_LENGTH && key[0] && key[1] && key[2] && key[3]) {
+		memcpy(&v, key, 4);
+		if (v & hibits)
+			break;
+		word[0] = (v & 0xff) | (v & 0xff00) << 8;
+		word[SIMD_COEF_32] = (v >> 16 & 0xff) | (v & 0xff000000) >> 8;
+		word += 2 * SIMD_COEF_32;
+		key += 4;
+		l += 4;
+	}
+	*keybuf_word = word;
+	*len = l;
+	return key;
+}
+#endif
+
 // ISO-8859-1 to UCS-2, directly into vector key buffer
 static void set_key(char *_key, int index)
 {
@@ -333,6 +363,9 @@ static void set_key(char *_key, int index)
 	unsigned int len, temp2;
 
 	len = 0;
+#if ARCH_LITTLE_ENDIAN
+	key = set_key_fast(key, &keybuf_word, &len, 0);
+#endif
 	while((temp2 = *key++)) {
 		unsigned int temp;
 		if ((temp = *key++) && len < PLAINTEXT_LENGTH - 1)
@@ -391,6 +424,9 @@ static void set_key_CP(char *_key, int index)
 	unsigned int len, temp2;
 
 	len = 0;
+#if ARCH_LITTLE_ENDIAN
+	key = set_key_fast(key, &keybuf_word, &len, 0x80808080);
+#endif
 	while((temp2 = *key++)) {
 		unsigned int temp;
 		temp2 = CP_to_Unicode[temp2];
@@ -436,6 +472,11 @@ static void set_key_utf8(char *_key, int index)
 	UTF32 chl, chh = 0x80;
 	unsigned int len = 0;
 
+#if ARCH_LITTLE_ENDIAN
+	source = set_key_fast(source, &keybuf_word, &len, 0x80808080);
+	if (len)
+		chh = 0; /* last pair was full, so terminate after it */
+#endif
 	while (*source) {
 		chl = *source;
 		if (chl >= 0xC0) {
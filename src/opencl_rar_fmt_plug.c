@@ -252,7 +252,7 @@ static void done(void)
 		HANDLE_CLERROR(clReleaseKernel(RarFinal), "Release kernel");
 		HANDLE_CLERROR(clReleaseProgram(program[gpu_id]), "Release Program");
 
-		MEM_FREE(unpack_data);
+		free_unpack_data();
 
 		autotuned--;
 	}
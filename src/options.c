@@ -194,7 +194,7 @@ static struct opt_entry opt_list[] = {
 		OPT_FMT_STR_ALLOC, &options.node_str},
 #if OS_FORK
 	{"fork", FLG_FORK, FLG_FORK,
-		FLG_CRACKING_CHK, FLG_STDIN_CHK | FLG_STDOUT | FLG_PIPE_CHK | OPT_REQ_PARAM,
+		0, FLG_STDIN_CHK | FLG_STDOUT | FLG_PIPE_CHK | OPT_REQ_PARAM,
 		"%u", &options.fork},
 #endif
 	{"pot", FLG_ZERO, 0, 0, OPT_REQ_PARAM,
@@ -253,6 +253,16 @@ static struct opt_entry opt_list[] = {
                 OPT_FMT_STR_ALLOC, &costs_str},
 
 	{"keep-guessing", FLG_KEEP_GUESSING, FLG_KEEP_GUESSING},
+	{"bench-json", FLG_ZERO, 0, FLG_TEST_CHK, OPT_REQ_PARAM,
+		OPT_FMT_STR_ALLOC, &options.bench_json},
+	{"bench-compare", FLG_ZERO, 0, FLG_TEST_CHK, OPT_REQ_PARAM,
+		OPT_FMT_STR_ALLOC, &options.bench_compare},
+	{"test-generator", FLG_TEST_GEN, FLG_TEST_GEN, FLG_CRACKING_CHK,
+		FLG_FORMAT | FLG_STDOUT},
+	{"test-load", FLG_ZERO, 0, FLG_CRACKING_CHK | FLG_FORMAT,
+		OPT_REQ_PARAM, "%u", &options.test_load},
+	{"metrics-socket", FLG_METRICS, FLG_METRICS, FLG_CRACKING_CHK, 0,
+		OPT_FMT_STR_ALLOC, &options.metrics_socket},
 	{"stress-test", FLG_LOOPTEST | FLG_TEST_SET, FLG_TEST_CHK,
 		0, ~FLG_TEST_SET & ~FLG_FORMAT & ~FLG_SAVEMEM & ~FLG_DYNFMT &
 		~OPT_REQ_PARAM & ~FLG_NOLOG, "%d", &benchmark_time},
@@ -402,6 +412,13 @@ void opt_print_hidden_usage(void)
 	puts("--skip-self-tests         skip self tests");
 	puts("--test-full[=LEVEL]       run more thorough self-tests");
 	puts("--stress-test[=TIME]      loop self tests forever");
+	puts("--bench-json=FILE         with --test, also write the results to FILE as JSON");
+	puts("--bench-compare=FILE      with --test, flag regressions against a JSON FILE");
+	puts("--test-generator          benchmark the cracking mode alone (no-op format)");
+	puts("--test-load=N             crack N synthetic hashes instead of password files");
+	puts("                          and report load time, lookup cost and memory");
+	puts("--metrics-socket[=PATH]   serve live status as JSON on a Unix socket");
+	puts("                          (default SESSION.sock)");
 #ifdef HAVE_FUZZ
 	puts("--fuzz[=DICTFILE]         fuzz formats' prepare(), valid() and split()");
 	puts("--fuzz-dump[=FROM,TO]     dump the fuzzed hashes between FROM and TO to file pwfile.format");
@@ -810,6 +827,31 @@ void opt_init(char *name, int argc, char **argv, int show_usage)
 
 	if (options.flags & FLG_STDOUT) options.flags &= ~FLG_PWD_REQ;
 
+	if (options.test_load || (options.flags & FLG_TEST_GEN)) {
+		char *name = options.test_load ?
+			"test-load" : "test-generator";
+
+		if ((options.flags & (FLG_PASSWD | FLG_STDOUT)) ||
+		    (options.test_load && (options.flags & FLG_TEST_GEN))) {
+			if (john_main_process)
+				fprintf(stderr, "Can't use --%s with password "
+				        "files, --stdout or another --test-* "
+				        "option\n", name);
+			error();
+		}
+		/* john_load() synthesizes the "file" */
+		options.flags |= FLG_PASSWD;
+		/* The no-op format would fail them */
+		if (options.flags & FLG_TEST_GEN)
+			options.flags |= FLG_NOTESTS;
+		if (!options.max_run_time)
+			options.max_run_time = 10;
+		if (!options.session) {
+			rec_name = name;
+			rec_name_completed = 0;
+		}
+	}
+
 #if OS_FORK
 	if ((options.flags & FLG_FORK) &&
 	    (options.fork < 2 || options.fork > 1024)) {
@@ -975,6 +1017,17 @@ void opt_init(char *name, int argc, char **argv, int show_usage)
 		}
 	}
 
+#if OS_FORK
+	/* --show splits the password files between processes */
+	if ((options.flags & FLG_FORK) &&
+	    !(options.flags & (FLG_CRACKING_CHK | FLG_SHOW_CHK))) {
+		if (john_main_process)
+			fprintf(stderr, "--fork requires a cracking mode, "
+			        "or --show (but not --show=left)\n");
+		error();
+	}
+#endif
+
 	if (options.dynamic_bare_hashes_always_valid == 'Y' || options.dynamic_bare_hashes_always_valid == 'y' ||
 		options.dynamic_bare_hashes_always_valid == '1' || options.dynamic_bare_hashes_always_valid == 't' || options.dynamic_bare_hashes_always_valid == 'T')
 		options.dynamic_bare_hashes_always_valid = 'Y';
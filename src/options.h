@@ -185,6 +185,10 @@
 #define FLG_PRINCE_MMAP			0x0100000000000000ULL
 #define FLG_RULES_ALLOW			0x0200000000000000ULL
 #define FLG_REGEX_STACKED		0x0400000000000000ULL
+/* Benchmark the cracking mode(s) against a format that does nothing */
+#define FLG_TEST_GEN			0x0800000000000000ULL
+/* Serve status snapshots on a local socket */
+#define FLG_METRICS			0x1000000000000000ULL
 
 /*
  * Structure with option flags and all the parameters.
@@ -334,6 +338,20 @@ struct options_main {
  */
 	int max_run_time;
 
+/*
+ * Instead of reading password files, load this many hashes synthesized
+ * from the format's test vectors and report load and cracking figures
+ * (--test-load=N)
+ */
+	unsigned int test_load;
+
+/* Write --test results as JSON to this file, and/or compare them to the
+ * results in a file written earlier */
+	char *bench_json, *bench_compare;
+
+/* Unix socket to serve live status on, NULL for the session's default */
+	char *metrics_socket;
+
 /* Emit a status line every N seconds */
 	int status_interval;
 
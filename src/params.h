@@ -197,6 +197,12 @@
  */
 #define PASSWORD_HASH_SIZE_FOR_LDR	5
 
+/*
+ * Salts (with their blobs) are allocated from chunks of this many slots,
+ * doubling with each chunk, so that they can be reordered in place.
+ */
+#define SALT_ARENA_SLOTS		64
+
 /*
  * Hash table sizes.  These may also be hardcoded into the hash functions.
  */
@@ -271,6 +277,13 @@ extern unsigned int password_hash_thresholds[PASSWORD_HASH_SIZES];
  */
 #define SINGLE_HASH_MIN			8
 
+/*
+ * Default cap (in MiB, for all salts together) on the candidate buffers when
+ * "single crack" mode buffers max_keys_per_crypt rather than min_keys_per_crypt
+ * keys per salt.  Overridden by SingleMaxBufferSize in john.conf.
+ */
+#define SINGLE_MAX_BUFFER_SIZE		32
+
 /*
  * Shadow file entry hash table size, used by unshadow.
  */
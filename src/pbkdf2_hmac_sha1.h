@@ -182,6 +182,10 @@ static void pbkdf2_sha1_sse(const unsigned char *K[SSE_GROUP_SZ_SHA1], int KL[SS
 
 	// sse_hash1 would need to be 'adjusted' for SHA1_PARA
 	JTR_ALIGN(MEM_ALIGN_SIMD) unsigned char sse_hash1[SHA_BUF_SIZ*sizeof(ARCH_WORD_32)*SSE_GROUP_SZ_SHA1];
+	// the running xor of all iterations, kept in the same interleaved layout
+	// as the first 5 words of sse_hash1, so the inner loop xor is a straight
+	// (vectorizable) walk instead of a per-lane strided gather.
+	JTR_ALIGN(MEM_ALIGN_SIMD) ARCH_WORD_32 acc[SSE_GROUP_SZ_SHA1*SHA_DIGEST_LENGTH/sizeof(ARCH_WORD_32)];
 	JTR_ALIGN(MEM_ALIGN_SIMD) unsigned char sse_crypt1[SHA_DIGEST_LENGTH*SSE_GROUP_SZ_SHA1];
 	JTR_ALIGN(MEM_ALIGN_SIMD) unsigned char sse_crypt2[SHA_DIGEST_LENGTH*SSE_GROUP_SZ_SHA1];
 	i1 = (ARCH_WORD_32*)sse_crypt1;
@@ -249,24 +253,28 @@ static void pbkdf2_sha1_sse(const unsigned char *K[SSE_GROUP_SZ_SHA1], int KL[SS
 			// Also, perform the 'first' ^= into the crypt buffer.  NOTE, we are doing that in BE format
 			// so we will need to 'undo' that in the end.
 			ptmp = &o1[(j/SIMD_COEF_32)*SIMD_COEF_32*SHA_BUF_SIZ+(j&(SIMD_COEF_32-1))];
-			ptmp[0]           = dgst[j][0] = ctx.h0;
-			ptmp[SIMD_COEF_32]    = dgst[j][1] = ctx.h1;
-			ptmp[SIMD_COEF_32*2]  = dgst[j][2] = ctx.h2;
-			ptmp[SIMD_COEF_32*3]  = dgst[j][3] = ctx.h3;
-			ptmp[SIMD_COEF_32*4]  = dgst[j][4] = ctx.h4;
+			ptmp[0]           = ctx.h0;
+			ptmp[SIMD_COEF_32]    = ctx.h1;
+			ptmp[SIMD_COEF_32*2]  = ctx.h2;
+			ptmp[SIMD_COEF_32*3]  = ctx.h3;
+			ptmp[SIMD_COEF_32*4]  = ctx.h4;
 		}
+		for (j = 0; j < SSE_GROUP_SZ_SHA1/SIMD_COEF_32; ++j)
+			memcpy(&acc[j*SIMD_COEF_32*(SHA_DIGEST_LENGTH/sizeof(ARCH_WORD_32))],
+			       &o1[j*SIMD_COEF_32*SHA_BUF_SIZ], SIMD_COEF_32*SHA_DIGEST_LENGTH);
 
 		// Here is the inner loop.  We loop from 1 to count.  iteration 0 was done in the ipad/opad computation.
 		for(i = 1; i < R; i++) {
 			SIMDSHA1body((unsigned char*)o1,o1,i1, SSEi_MIXED_IN|SSEi_RELOAD|SSEi_OUTPUT_AS_INP_FMT);
 			SIMDSHA1body((unsigned char*)o1,o1,i2, SSEi_MIXED_IN|SSEi_RELOAD|SSEi_OUTPUT_AS_INP_FMT);
 #if !defined (PBKDF1_LOGIC)
-			for (k = 0; k < SSE_GROUP_SZ_SHA1; k++) {
-				unsigned *p = &o1[(k/SIMD_COEF_32)*SIMD_COEF_32*SHA_BUF_SIZ + (k&(SIMD_COEF_32-1))];
-				for(j = 0; j < (SHA_DIGEST_LENGTH/sizeof(ARCH_WORD_32)); j++) {
-					dgst[k][j] ^= p[(j*SIMD_COEF_32)];
+			for (k = 0; k < SSE_GROUP_SZ_SHA1/SIMD_COEF_32; k++) {
+				ARCH_WORD_32 *p = &o1[k*SIMD_COEF_32*SHA_BUF_SIZ];
+				ARCH_WORD_32 *d = &acc[k*SIMD_COEF_32*(SHA_DIGEST_LENGTH/sizeof(ARCH_WORD_32))];
+				for (j = 0; j < SIMD_COEF_32*(SHA_DIGEST_LENGTH/sizeof(ARCH_WORD_32)); j++) {
+					d[j] ^= p[j];
 #if defined (EFS_CRAP_LOGIC)
-					p[(j*SIMD_COEF_32)] = dgst[k][j];
+					p[j] = d[j];
 #endif
 				}
 			}
@@ -274,12 +282,16 @@ static void pbkdf2_sha1_sse(const unsigned char *K[SSE_GROUP_SZ_SHA1], int KL[SS
 		}
 #if defined (PBKDF1_LOGIC)
 		// PBKDF1 simply uses the end 'result' of all of the HMAC iterations.
+		for (k = 0; k < SSE_GROUP_SZ_SHA1/SIMD_COEF_32; k++)
+			memcpy(&acc[k*SIMD_COEF_32*(SHA_DIGEST_LENGTH/sizeof(ARCH_WORD_32))],
+			       &o1[k*SIMD_COEF_32*SHA_BUF_SIZ], SIMD_COEF_32*SHA_DIGEST_LENGTH);
+#endif
+		// back from interleaved to one flat digest per lane
 		for (k = 0; k < SSE_GROUP_SZ_SHA1; k++) {
-			unsigned *p = &o1[(k/SIMD_COEF_32)*SIMD_COEF_32*SHA_BUF_SIZ + (k&(SIMD_COEF_32-1))];
-			for(j = 0; j < (SHA_DIGEST_LENGTH/sizeof(ARCH_WORD_32)); j++)
-				dgst[k][j] = p[(j*SIMD_COEF_32)];
+			ptmp = &acc[(k/SIMD_COEF_32)*SIMD_COEF_32*(SHA_DIGEST_LENGTH/sizeof(ARCH_WORD_32))+(k&(SIMD_COEF_32-1))];
+			for (j = 0; j < (SHA_DIGEST_LENGTH/sizeof(ARCH_WORD_32)); j++)
+				dgst[k][j] = ptmp[j*SIMD_COEF_32];
 		}
-#endif
 
 		// we must fixup final results.  We have been working in BE (NOT switching out of, just to switch back into it at every loop).
 		// for the 'very' end of the crypt, we remove BE logic, so the calling function can view it in native format.
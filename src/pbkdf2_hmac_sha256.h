@@ -208,6 +208,9 @@ static void pbkdf2_sha256_sse(const unsigned char *K[SSE_GROUP_SZ_SHA256], int K
 
 	// sse_hash1 would need to be 'adjusted' for SHA256_PARA
 	JTR_ALIGN(MEM_ALIGN_SIMD) unsigned char sse_hash1[SHA_BUF_SIZ*sizeof(ARCH_WORD_32)*SSE_GROUP_SZ_SHA256];
+	// the running xor of all iterations, in the same interleaved layout as
+	// the digest words of sse_hash1 so the inner loop xor is a straight walk.
+	JTR_ALIGN(MEM_ALIGN_SIMD) ARCH_WORD_32 acc[SSE_GROUP_SZ_SHA256*SHA256_DIGEST_LENGTH/sizeof(ARCH_WORD_32)];
 	JTR_ALIGN(MEM_ALIGN_SIMD) unsigned char sse_crypt1[SHA256_DIGEST_LENGTH*SSE_GROUP_SZ_SHA256];
 	JTR_ALIGN(MEM_ALIGN_SIMD) unsigned char sse_crypt2[SHA256_DIGEST_LENGTH*SSE_GROUP_SZ_SHA256];
 	i1 = (ARCH_WORD_32*)sse_crypt1;
@@ -279,13 +282,15 @@ static void pbkdf2_sha256_sse(const unsigned char *K[SSE_GROUP_SZ_SHA256], int K
 			ptmp = &o1[(j/SIMD_COEF_32)*SIMD_COEF_32*SHA_BUF_SIZ+(j&(SIMD_COEF_32-1))];
 			for (i = 0; i < (SHA256_DIGEST_LENGTH/sizeof(ARCH_WORD_32)); ++i) {
 #if COMMON_DIGEST_FOR_OPENSSL
-				*ptmp = dgst[j][i] = ctx.hash[i];
+				*ptmp = ctx.hash[i];
 #else
-				*ptmp = dgst[j][i] = ctx.h[i];
+				*ptmp = ctx.h[i];
 #endif
 				ptmp += SIMD_COEF_32;
 			}
 		}
+		for (j = 0; j < SSE_GROUP_SZ_SHA256/SIMD_COEF_32; ++j)
+			memcpy(&acc[j*SIMD_COEF_32*(SHA256_DIGEST_LENGTH/sizeof(ARCH_WORD_32))], &o1[j*SIMD_COEF_32*SHA_BUF_SIZ], SIMD_COEF_32*SHA256_DIGEST_LENGTH);
 
 		// Here is the inner loop.  We loop from 1 to count.  iteration 0 was done in the ipad/opad computation.
 		for(i = 1; i < (unsigned)R; i++) {
@@ -293,12 +298,19 @@ static void pbkdf2_sha256_sse(const unsigned char *K[SSE_GROUP_SZ_SHA256], int K
 			SIMDSHA256body(o1,o1,i1, SSEi_MIXED_IN|SSEi_RELOAD|SSEi_OUTPUT_AS_INP_FMT);
 			SIMDSHA256body(o1,o1,i2, SSEi_MIXED_IN|SSEi_RELOAD|SSEi_OUTPUT_AS_INP_FMT);
 			// only xor first 16 words
-			for (k = 0; k < SSE_GROUP_SZ_SHA256; k++) {
-				ARCH_WORD_32 *p = &o1[(k/SIMD_COEF_32)*SIMD_COEF_32*SHA_BUF_SIZ + (k&(SIMD_COEF_32-1))];
-				for(j = 0; j < (SHA256_DIGEST_LENGTH/sizeof(ARCH_WORD_32)); j++)
-					dgst[k][j] ^= p[(j*SIMD_COEF_32)];
+			for (k = 0; k < SSE_GROUP_SZ_SHA256/SIMD_COEF_32; k++) {
+				ARCH_WORD_32 *p = &o1[k*SIMD_COEF_32*SHA_BUF_SIZ];
+				ARCH_WORD_32 *d = &acc[k*SIMD_COEF_32*(SHA256_DIGEST_LENGTH/sizeof(ARCH_WORD_32))];
+				for (j = 0; j < SIMD_COEF_32*(SHA256_DIGEST_LENGTH/sizeof(ARCH_WORD_32)); j++)
+					d[j] ^= p[j];
 			}
 		}
+		// back from interleaved to one flat digest per lane
+		for (j = 0; j < SSE_GROUP_SZ_SHA256; ++j) {
+			ptmp = &acc[(j/SIMD_COEF_32)*SIMD_COEF_32*(SHA256_DIGEST_LENGTH/sizeof(ARCH_WORD_32))+(j&(SIMD_COEF_32-1))];
+			for (i = 0; i < (SHA256_DIGEST_LENGTH/sizeof(ARCH_WORD_32)); ++i)
+				dgst[j][i] = ptmp[i*SIMD_COEF_32];
+		}
 
 		// we must fixup final results.  We have been working in BE (NOT switching out of, just to switch back into it at every loop).
 		// for the 'very' end of the crypt, we remove BE logic, so the calling function can view it in native format.
@@ -206,6 +206,9 @@ static void pbkdf2_sha512_sse(const unsigned char *K[SSE_GROUP_SZ_SHA512], int K
 
 	// sse_hash1 would need to be 'adjusted' for SHA512_PARA
 	JTR_ALIGN(MEM_ALIGN_SIMD) unsigned char sse_hash1[SHA_BUF_SIZ*sizeof(ARCH_WORD_64)*SSE_GROUP_SZ_SHA512];
+	// the running xor of all iterations, in the same interleaved layout as
+	// the digest words of sse_hash1 so the inner loop xor is a straight walk.
+	JTR_ALIGN(MEM_ALIGN_SIMD) ARCH_WORD_64 acc[SSE_GROUP_SZ_SHA512*SHA512_DIGEST_LENGTH/sizeof(ARCH_WORD_64)];
 	JTR_ALIGN(MEM_ALIGN_SIMD) unsigned char sse_crypt1[SHA512_DIGEST_LENGTH*SSE_GROUP_SZ_SHA512];
 	JTR_ALIGN(MEM_ALIGN_SIMD) unsigned char sse_crypt2[SHA512_DIGEST_LENGTH*SSE_GROUP_SZ_SHA512];
 	i1 = (ARCH_WORD_64*)sse_crypt1;
@@ -277,13 +280,15 @@ static void pbkdf2_sha512_sse(const unsigned char *K[SSE_GROUP_SZ_SHA512], int K
 			ptmp = &o1[(j/SIMD_COEF_64)*SIMD_COEF_64*SHA_BUF_SIZ+(j&(SIMD_COEF_64-1))];
 			for (i = 0; i < (SHA512_DIGEST_LENGTH/sizeof(ARCH_WORD_64)); ++i) {
 #if COMMON_DIGEST_FOR_OPENSSL
-				*ptmp = dgst[j][i] = ctx.hash[i];
+				*ptmp = ctx.hash[i];
 #else
-				*ptmp = dgst[j][i] = ctx.h[i];
+				*ptmp = ctx.h[i];
 #endif
 				ptmp += SIMD_COEF_64;
 			}
 		}
+		for (j = 0; j < SSE_GROUP_SZ_SHA512/SIMD_COEF_64; ++j)
+			memcpy(&acc[j*SIMD_COEF_64*(SHA512_DIGEST_LENGTH/sizeof(ARCH_WORD_64))], &o1[j*SIMD_COEF_64*SHA_BUF_SIZ], SIMD_COEF_64*SHA512_DIGEST_LENGTH);
 
 		// Here is the inner loop.  We loop from 1 to count.  iteration 0 was done in the ipad/opad computation.
 		for(i = 1; i < R; i++) {
@@ -291,12 +296,19 @@ static void pbkdf2_sha512_sse(const unsigned char *K[SSE_GROUP_SZ_SHA512], int K
 			SIMDSHA512body(o1,o1,i1, SSEi_MIXED_IN|SSEi_RELOAD|SSEi_OUTPUT_AS_INP_FMT);
 			SIMDSHA512body(o1,o1,i2, SSEi_MIXED_IN|SSEi_RELOAD|SSEi_OUTPUT_AS_INP_FMT);
 			// only xor first 16 64-bit words
-			for (k = 0; k < SSE_GROUP_SZ_SHA512; k++) {
-				ARCH_WORD_64 *p = &o1[(k/SIMD_COEF_64)*SIMD_COEF_64*SHA_BUF_SIZ + (k&(SIMD_COEF_64-1))];
-				for(j = 0; j < (SHA512_DIGEST_LENGTH/sizeof(ARCH_WORD_64)); j++)
-					dgst[k][j] ^= p[j*SIMD_COEF_64];
+			for (k = 0; k < SSE_GROUP_SZ_SHA512/SIMD_COEF_64; k++) {
+				ARCH_WORD_64 *p = &o1[k*SIMD_COEF_64*SHA_BUF_SIZ];
+				ARCH_WORD_64 *d = &acc[k*SIMD_COEF_64*(SHA512_DIGEST_LENGTH/sizeof(ARCH_WORD_64))];
+				for (j = 0; j < SIMD_COEF_64*(SHA512_DIGEST_LENGTH/sizeof(ARCH_WORD_64)); j++)
+					d[j] ^= p[j];
 			}
 		}
+		// back from interleaved to one flat digest per lane
+		for (j = 0; j < SSE_GROUP_SZ_SHA512; ++j) {
+			ptmp = &acc[(j/SIMD_COEF_64)*SIMD_COEF_64*(SHA512_DIGEST_LENGTH/sizeof(ARCH_WORD_64))+(j&(SIMD_COEF_64-1))];
+			for (i = 0; i < (SHA512_DIGEST_LENGTH/sizeof(ARCH_WORD_64)); ++i)
+				dgst[j][i] = ptmp[i*SIMD_COEF_64];
+		}
 
 		// we must fixup final results.  We have been working in BE (NOT switching out of, just to switch back into it at every loop).
 		// for the 'very' end of the crypt, we remove BE logic, so the calling function can view it in native format.
@@ -872,8 +872,9 @@ static int cmp_exact_loadfile(int index)
 static int cmp_exact(char *source, int index)
 {
 	const u8 *b;
-	u8 C, *decompBuf, *decrBuf, *B;
-	u32 k, crc;
+	u8 C, *B;
+	u32 k;
+	CRC32_t crc;
 	MY_WORD key0, key1, key2;
 	z_stream strm;
 	int ret;
@@ -889,10 +890,12 @@ static int cmp_exact(char *source, int index)
 #endif
 
 	if (salt->fname[0] == 0) {
-		/* we have the whole zip blob in memory, simply allocate a decrypt buffer, decrypt
-		 * in one step, crc and be done with it. This is the 'trivial' type. */
-
-		decrBuf = mem_alloc(salt->compLen-12);
+		/* we have the whole zip blob in memory (in the salt). Decrypt it
+		 * a chunk at a time straight from there, and inflate and crc as
+		 * we go. No per-candidate copy of the blob is ever made. */
+		u8 decrBuf[CHUNK], decompBuf[CHUNK];
+		int stored = (salt->H[salt->full_zip_idx].compType == 0);
+		u32 left = salt->compLen - 12;
 
 		key0.u = K12[index*3], key1.u = K12[index*3+1], key2.u = K12[index*3+2];
 
@@ -905,51 +908,57 @@ static int cmp_exact(char *source, int index)
 			key2.u = jtr_crc32 (key2.u, key1.c[KB2]);
 		}
 		while(--k);
-		B = decrBuf;
-		k = salt->compLen-12;
-		do {
-			C = PKZ_MULT(*b++,key2);
-			key0.u = jtr_crc32 (key0.u, C);
-			*B++ = C;
-			key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
-			key2.u = jtr_crc32 (key2.u, key1.c[KB2]);
-		} while (--k);
-
-		if (salt->H[salt->full_zip_idx].compType == 0) {
-			// handle a stored blob (we do not have to decrypt it.
-			crc = 0xFFFFFFFF;
-			for (k = 0; k < salt->compLen-12; ++k)
-				crc = jtr_crc32(crc,decrBuf[k]);
-			MEM_FREE(decrBuf);
-			return ~crc == salt->crc32;
-		}
 
-		strm.zalloc = Z_NULL; strm.zfree = Z_NULL; strm.opaque = Z_NULL; strm.next_in = Z_NULL; strm.avail_in = 0;
+		if (!stored) {
+			strm.zalloc = Z_NULL; strm.zfree = Z_NULL; strm.opaque = Z_NULL; strm.next_in = Z_NULL; strm.avail_in = 0;
 
-		ret = inflateInit2(&strm, -15); /* 'raw', since we do not have gzip header, or gzip crc. .ZIP files are 'raw' implode data. */
-		if (ret != Z_OK)
-		   perror("Error, initializing the libz inflateInit2() system\n");
+			ret = inflateInit2(&strm, -15); /* 'raw', since we do not have gzip header, or gzip crc. .ZIP files are 'raw' implode data. */
+			if (ret != Z_OK)
+			   perror("Error, initializing the libz inflateInit2() system\n");
+		}
+		ret = Z_OK;
 
-		decompBuf = mem_alloc(salt->deCompLen);
+		CRC32_Init(&crc);
+		while (left && ret != Z_STREAM_END) {
+			u32 len = MIN(left, sizeof(decrBuf));
 
-		strm.next_in = decrBuf;
-		strm.avail_in = salt->compLen-12;
-		strm.avail_out = salt->deCompLen;
-		strm.next_out = decompBuf;
+			B = decrBuf;
+			k = len;
+			do {
+				C = PKZ_MULT(*b++,key2);
+				key0.u = jtr_crc32 (key0.u, C);
+				*B++ = C;
+				key1.u = (key1.u + key0.c[KB1]) * 134775813 + 1;
+				key2.u = jtr_crc32 (key2.u, key1.c[KB2]);
+			} while (--k);
+			left -= len;
 
-		ret = inflate(&strm, Z_SYNC_FLUSH);
-		inflateEnd(&strm);
-		if (ret != Z_STREAM_END || strm.total_out != salt->deCompLen) {
-			MEM_FREE(decompBuf);
-			MEM_FREE(decrBuf);
-			return 0;
+			if (stored) {
+				// handle a stored blob (we do not have to inflate it.
+				CRC32_Update(&crc, decrBuf, len);
+				continue;
+			}
+
+			strm.next_in = decrBuf;
+			strm.avail_in = len;
+			do {
+				strm.next_out = decompBuf;
+				strm.avail_out = sizeof(decompBuf);
+				ret = inflate(&strm, Z_SYNC_FLUSH);
+				if ((ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) ||
+				    strm.total_out > salt->deCompLen) {
+					inflateEnd(&strm);
+					return 0;
+				}
+				CRC32_Update(&crc, decompBuf, sizeof(decompBuf) - strm.avail_out);
+			} while (strm.avail_out == 0 && ret != Z_STREAM_END);
 		}
 
-		crc = 0xFFFFFFFF;
-		for (k = 0; k < strm.total_out; ++k)
-			crc = jtr_crc32(crc,decompBuf[k]);
-		MEM_FREE(decompBuf);
-		MEM_FREE(decrBuf);
+		if (!stored) {
+			inflateEnd(&strm);
+			if (ret != Z_STREAM_END || strm.total_out != salt->deCompLen)
+				return 0;
+		}
 		return ~crc == salt->crc32;
 	}
 	/* we have a stand alone function to handle this more complex method of
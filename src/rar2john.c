@@ -63,6 +63,7 @@
 #include "base64_convert.h"
 #include "sha2.h"
 #include "rar2john.h"
+#include "filepool.h"
 #ifdef _MSC_VER
 #include "missing_getopt.h"
 #endif
@@ -71,6 +72,7 @@
 #define CHUNK_SIZE 4096
 
 static int verbose;
+static uint64_t max_inline;
 
 static int process_file5(const char *archive_name);
 
@@ -161,6 +163,32 @@ static void DecodeFileName(unsigned char *Name, unsigned char *EncName,
 	NameW[DecPos < MaxDecSize ? DecPos : MaxDecSize - 1] = 0;
 }
 
+/*
+ * Copies len bytes from fp to stdout as hex, a chunk at a time, so that
+ * huge files never need to be held in memory.
+ */
+static void print_hex(FILE *fp, uint64_t len)
+{
+	unsigned char buf[CHUNK_SIZE];
+	char hex[2 * CHUNK_SIZE];
+
+	while (len) {
+		size_t i, count = len < CHUNK_SIZE ? len : CHUNK_SIZE;
+
+		if (fread(buf, 1, count, fp) != count) {
+			fprintf(stderr, "Error while reading archive: %s\n",
+			        strerror(errno));
+			return;
+		}
+		for (i = 0; i < count; i++) {
+			hex[2 * i] = itoa16[buf[i] >> 4];
+			hex[2 * i + 1] = itoa16[buf[i] & 0xf];
+		}
+		fwrite(hex, 1, 2 * count, stdout);
+		len -= count;
+	}
+}
+
 static void process_file(const char *archive_name)
 {
 	FILE *fp;
@@ -178,6 +206,9 @@ static void process_file(const char *archive_name)
 	char path[PATH_BUFFER_SIZE];
 	char *gecos, *best = NULL;
 	int best_len = 0, gecos_len = 0;
+	int64_t best_pos = 0;
+	uint64_t best_pack_size = 0;
+	unsigned char best_method = 0;
 
 	/* We misuse PATH_BUFFER_SIZE as a sane maximum for this */
 	gecos = mem_calloc(1, PATH_BUFFER_SIZE);
@@ -322,8 +353,6 @@ next_file_header:
 		unsigned char file_name[256], file_crc[4];
 		unsigned char salt[8] = { 0 };
 		char rejbuf[32];
-		char *p;
-		unsigned char s;
 
 		if (!(file_header_head_flags & 0x8000)) {
 			fprintf(stderr, "File header flag 0x8000 unset, bailing out.\n");
@@ -485,8 +514,8 @@ next_file_header:
 
 		bestsize = file_header_unp_size;
 
-		MEM_FREE(best);
-		best = mem_calloc(1, LINE_BUFFER_SIZE + 2 * file_header_pack_size);
+		if (!best)
+			best = mem_calloc(1, LINE_BUFFER_SIZE);
 
 		/* process encrypted data of size "file_header_pack_size" */
 		best_len = sprintf(best, "%s:$RAR3$*%d*", base_aname, type);
@@ -524,29 +553,43 @@ next_file_header:
 		        (unsigned long long)file_header_pack_size,
 		        (unsigned long long)file_header_unp_size);
 
-		/* We always store it inline */
-
-		best_len += sprintf(&best[best_len], "1*");
-		p = &best[best_len];
-		for (i = 0; i < file_header_pack_size; i++) {
-			if (fread(&s, 1, 1, fp) != 1)
-				fprintf(stderr, "Error while reading archive: %s\n", strerror(errno));
-			*p++ = itoa16[s >> 4];
-			*p++ = itoa16[s & 0xf];
-		}
-		best_len += file_header_pack_size;
-		best_len += sprintf(p, "*%c%c:%d::", itoa16[file_header_block[25]>>4], itoa16[file_header_block[25]&0xf], type);
+		/*
+		 * The encrypted data is only read (and hex encoded straight
+		 * to stdout) once we know this is the best candidate.
+		 */
+		best_pos = jtr_ftell64(fp);
+		best_pack_size = file_header_pack_size;
+		best_method = file_header_block[25];
+		jtr_fseek64(fp, file_header_pack_size, SEEK_CUR);
 
 		/* Keep looking for better candidates */
 		goto next_file_header;
 
 BailOut:
 		if (best && *best) {
+			int room;
+
 			if (verbose) {
 				fprintf(stderr, "Found a valid -p mode candidate in %s\n", base_aname);
 			}
-			strncat(best, gecos, LINE_BUFFER_SIZE - best_len - 1);
-			puts(best);
+			fputs(best, stdout);
+			if (max_inline && best_pack_size > max_inline) {
+				room = LINE_BUFFER_SIZE - best_len - 1 -
+					printf("0*%s*"LLd, archive_name,
+					       (long long)best_pos);
+			} else {
+				printf("1*");
+				jtr_fseek64(fp, best_pos, SEEK_SET);
+				print_hex(fp, best_pack_size);
+				room = LINE_BUFFER_SIZE - best_len - 2 -
+					(int)best_pack_size - 1;
+			}
+			room -= printf("*%c%c:%d::", itoa16[best_method >> 4],
+			               itoa16[best_method & 0xf], type);
+			/* Same cap on the GECOS field as we always had */
+			if (room >= 0 && room < gecos_len)
+				gecos_len = room;
+			printf("%.*s\n", gecos_len, gecos);
 		} else
 			fprintf(stderr, "Did not find a valid encrypted candidate in %s\n", base_aname);
 	}
@@ -824,20 +867,29 @@ err:;
 
 static int usage(char *name)
 {
-	fprintf(stderr,"Usage: %s <rar file(s)>\n", name);
+	fprintf(stderr,"Usage: %s [-v] [-j N] [-s SIZE] <rar file(s)>\n", name);
+	fprintf(stderr, " -j N     process N archives at a time (output order is kept)\n");
+	fprintf(stderr, " -s SIZE  don't inline encrypted data larger than SIZE bytes, refer to\n");
+	fprintf(stderr, "          the archive instead (which then has to be kept in place)\n");
 	return EXIT_FAILURE;
 }
 
 int rar2john(int argc, char **argv)
 {
-	int c;
+	int c, jobs = 1;
 
 	/* Parse command line */
-	while ((c = getopt(argc, argv, "v")) != -1) {
+	while ((c = getopt(argc, argv, "vj:s:")) != -1) {
 		switch (c) {
 		case 'v':
 			verbose = 1;
 			break;
+		case 'j':
+			jobs = filepool_jobs(optarg);
+			break;
+		case 's':
+			max_inline = atoll(optarg);
+			break;
 		case '?':
 		default:
 			return usage(argv[0]);
@@ -848,8 +900,7 @@ int rar2john(int argc, char **argv)
 		return usage(argv[0]);
 	argv += optind;
 
-	while (argc--)
-		process_file(*argv++);
+	filepool_run(argc, argv, jobs, process_file);
 
 	return EXIT_SUCCESS;
 }
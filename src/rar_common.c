@@ -7,6 +7,7 @@
  */
 
 #include "misc.h"	// error()
+#include "aes_crc32.h"
 
 static int omp_t = 1;
 static unsigned char *saved_salt;
@@ -501,6 +502,16 @@ static MAYBE_INLINE int check_huffman(unsigned char *next) {
 	return 1; /* Passed this check! */
 }
 
+/* Free the unpack state rar_unpack29() keeps around between candidates */
+static void free_unpack_data(void)
+{
+	int i;
+
+	for (i = 0; i < omp_t; i++)
+		rar_unpack_free(&unpack_data[i]);
+	MEM_FREE(unpack_data);
+}
+
 static int cmp_all(void *binary, int count)
 {
 	int index;
@@ -521,100 +532,172 @@ static int cmp_exact(char *source, int index)
 	return 1;
 }
 
+/*
+ * First-block decryption for a run of RAR_AES_X consecutive candidates.
+ * With AES-NI we expand all the key schedules and run all the blocks
+ * side by side, so the aeskeygenassist/aesdec latencies of one key hide
+ * behind the others. Decryption uses the equivalent inverse cipher, the
+ * middle round keys are simply aesimc'ed as they are used.
+ */
+#ifdef __AES__
+#include <wmmintrin.h>
+
+#define RAR_AES_X	4
+
+#define RAR_EXPAND(r, rcon)	  \
+	for (j = 0; j < n; j++) { \
+		__m128i k = rk[r - 1][j], t; \
+		t = _mm_shuffle_epi32(_mm_aeskeygenassist_si128(k, rcon), 0xff); \
+		k = _mm_xor_si128(k, _mm_slli_si128(k, 4)); \
+		k = _mm_xor_si128(k, _mm_slli_si128(k, 4)); \
+		k = _mm_xor_si128(k, _mm_slli_si128(k, 4)); \
+		rk[r][j] = _mm_xor_si128(k, t); \
+	}
+
+static void rar_first_block(unsigned char *plain, unsigned int index, int n)
+{
+	__m128i rk[11][RAR_AES_X], b[RAR_AES_X];
+	__m128i c = _mm_loadu_si128((__m128i*)cur_file->blob);
+	int j, r;
+
+	for (j = 0; j < n; j++)
+		rk[0][j] = _mm_loadu_si128((__m128i*)&aes_key[(index + j) * 16]);
+	RAR_EXPAND(1, 0x01); RAR_EXPAND(2, 0x02); RAR_EXPAND(3, 0x04);
+	RAR_EXPAND(4, 0x08); RAR_EXPAND(5, 0x10); RAR_EXPAND(6, 0x20);
+	RAR_EXPAND(7, 0x40); RAR_EXPAND(8, 0x80); RAR_EXPAND(9, 0x1b);
+	RAR_EXPAND(10, 0x36);
+
+	for (j = 0; j < n; j++)
+		b[j] = _mm_xor_si128(c, rk[10][j]);
+	for (r = 9; r > 0; r--)
+		for (j = 0; j < n; j++)
+			b[j] = _mm_aesdec_si128(b[j], _mm_aesimc_si128(rk[r][j]));
+	for (j = 0; j < n; j++) {
+		b[j] = _mm_aesdeclast_si128(b[j], rk[0][j]);
+		b[j] = _mm_xor_si128(b[j], _mm_loadu_si128(
+			(__m128i*)&aes_iv[(index + j) * 16]));
+		_mm_storeu_si128((__m128i*)&plain[j * 16], b[j]);
+	}
+}
+#undef RAR_EXPAND
+
+#else
+#define RAR_AES_X	1
+
+static void rar_first_block(unsigned char *plain, unsigned int index, int n)
+{
+	AES_KEY aes_ctx;
+	unsigned char iv[16];
+
+	memcpy(iv, &aes_iv[index * 16], 16);
+	AES_set_decrypt_key(&aes_key[index * 16], 128, &aes_ctx);
+	AES_cbc_encrypt(cur_file->blob, plain, 16, &aes_ctx, iv, AES_DECRYPT);
+}
+#endif
+
+/*
+ * Early rejection on the first decrypted block of a compressed file.
+ * Returns non-zero if the block could be the start of a RAR3 stream.
+ */
+static MAYBE_INLINE int check_first_block(unsigned char *plain)
+{
+	if (plain[0] & 0x80) {
+		// PPM checks here.
+		if (!(plain[0] & 0x20) ||  // Reset bit must be set
+		    (plain[1] & 0x80))     // MaxMB must be < 128
+			return 0;
+	} else {
+		// LZ checks here.
+		if ((plain[0] & 0x40) ||   // KeepOldTable can't be set
+		    !check_huffman(plain)) // Huffman table check
+			return 0;
+	}
+	return 1;
+}
+
 static inline void check_rar(int count)
 {
-	unsigned int index;
+	int index;
 
+	if (cur_file->type && cur_file->method == 0x30) {
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-	for (index = 0; index < count; index++) {
-		AES_KEY aes_ctx;
-		unsigned char *key = &aes_key[index * 16];
-		unsigned char *iv = &aes_iv[index * 16];
+		for (index = 0; index < count; index++) {
+			CRC32_t crc;
+			unsigned char crc_out[4];
+
+			/* stored, not deflated: Use full decryption with CRC
+			   check. Compute CRC of the decompressed plaintext */
+			CRC32_Init(&crc);
+			AES_cbc_decrypt_crc32(&aes_key[index * 16], 128,
+			                      cur_file->blob, cur_file->unp_size,
+			                      &aes_iv[index * 16], &crc);
+			CRC32_Final(crc_out, crc);
+
+			/* Compare computed CRC with stored CRC */
+			cracked[index] = !memcmp(crc_out, &cur_file->crc.c, 4);
+		}
+		return;
+	}
 
-		AES_set_decrypt_key(key, 128, &aes_ctx);
+	/*
+	 * Batched first stage: decrypt the first block under every key of
+	 * the batch and run the cheap checks. For rar-hp this is the whole
+	 * job, for compressed files it leaves a (usually empty) set of
+	 * survivors in cracked[] for the full unpack below.
+	 */
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+	for (index = 0; index < count; index += RAR_AES_X) {
+		unsigned char plain[RAR_AES_X * 16 + 4];
+		int j, n = count - index;
+
+		if (n > RAR_AES_X)
+			n = RAR_AES_X;
+		rar_first_block(plain, index, n);
+
+		for (j = 0; j < n; j++) {
+			unsigned char *p = &plain[j * 16];
+
+			if (cur_file->type == 0)	/* rar-hp mode */
+				cracked[index + j] =
+					!memcmp(p, "\xc4\x3d\x7b\x00\x40\x07\x00", 7);
+			else
+				cracked[index + j] = check_first_block(p);
+		}
+	}
 
-		/* AES decrypt, uses aes_iv, aes_key and blob */
-		if (cur_file->type == 0) {	/* rar-hp mode */
-			unsigned char plain[16];
+	if (cur_file->type == 0)
+		return;
 
-			AES_cbc_encrypt(cur_file->blob, plain, 16,
-			                &aes_ctx, iv, AES_DECRYPT);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+	for (index = 0; index < count; index++) {
+		const int solid = 0;
+		AES_KEY aes_ctx;
+		unpack_data_t *unpack_t;
 
-			cracked[index] = !memcmp(plain, "\xc4\x3d\x7b\x00\x40\x07\x00", 7);
-		} else {
-			if (cur_file->method == 0x30) {	/* stored, not deflated */
-				CRC32_t crc;
-				unsigned char crc_out[4];
-				unsigned char plain[0x8000];
-				unsigned long long size = cur_file->unp_size;
-				unsigned char *cipher = cur_file->blob;
-
-				/* Use full decryption with CRC check.
-				   Compute CRC of the decompressed plaintext */
-				CRC32_Init(&crc);
-
-				while (size) {
-					unsigned int inlen = (size > 0x8000) ? 0x8000 : size;
-
-					AES_cbc_encrypt(cipher, plain, inlen,
-					                &aes_ctx, iv, AES_DECRYPT);
-
-					CRC32_Update(&crc, plain, inlen);
-					size -= inlen;
-					cipher += inlen;
-				}
-				CRC32_Final(crc_out, crc);
-
-				/* Compare computed CRC with stored CRC */
-				cracked[index] = !memcmp(crc_out, &cur_file->crc.c, 4);
-			} else {
-				const int solid = 0;
-				unpack_data_t *unpack_t;
-				unsigned char plain[20];
-				unsigned char pre_iv[16];
-
-				cracked[index] = 0;
-
-				memcpy(pre_iv, iv, 16);
-
-				/* Decrypt just one block for early rejection */
-				AES_cbc_encrypt(cur_file->blob, plain, 16,
-				                &aes_ctx, pre_iv, AES_DECRYPT);
-
-				/* Early rejection */
-				if (plain[0] & 0x80) {
-					// PPM checks here.
-					if (!(plain[0] & 0x20) ||  // Reset bit must be set
-					    (plain[1] & 0x80))     // MaxMB must be < 128
-						goto bailOut;
-				} else {
-					// LZ checks here.
-					if ((plain[0] & 0x40) ||   // KeepOldTable can't be set
-					    !check_huffman(plain)) // Huffman table check
-						goto bailOut;
-				}
-
-				/* Reset stuff for full check */
-				AES_set_decrypt_key(key, 128, &aes_ctx);
+		if (!cracked[index])
+			continue;
+
+		AES_set_decrypt_key(&aes_key[index * 16], 128, &aes_ctx);
 
 #ifdef _OPENMP
-				unpack_t = &unpack_data[omp_get_thread_num()];
+		unpack_t = &unpack_data[omp_get_thread_num()];
 #else
-				unpack_t = unpack_data;
+		unpack_t = unpack_data;
 #endif
-				unpack_t->max_size = cur_file->unp_size;
-				unpack_t->dest_unp_size = cur_file->unp_size;
-				unpack_t->pack_size = cur_file->pack_size;
-				unpack_t->iv = iv;
-				unpack_t->ctx = &aes_ctx;
-				unpack_t->key = key;
-
-				if (rar_unpack29(cur_file->blob, solid, unpack_t))
-					cracked[index] = !memcmp(&unpack_t->unp_crc, &cur_file->crc.c, 4);
-bailOut:;
-			}
-		}
+		unpack_t->max_size = cur_file->unp_size;
+		unpack_t->dest_unp_size = cur_file->unp_size;
+		unpack_t->pack_size = cur_file->pack_size;
+		unpack_t->iv = &aes_iv[index * 16];
+		unpack_t->ctx = &aes_ctx;
+		unpack_t->key = &aes_key[index * 16];
+
+		cracked[index] = rar_unpack29(cur_file->blob, solid, unpack_t) &&
+			!memcmp(&unpack_t->unp_crc, &cur_file->crc.c, 4);
 	}
 }
@@ -191,7 +191,7 @@ static void done(void)
 	MEM_FREE(saved_len);
 	MEM_FREE(saved_key);
 	MEM_FREE(cracked);
-	MEM_FREE(unpack_data);
+	free_unpack_data();
 	MEM_FREE(saved_salt);
 #ifdef SIMD_COEF_32
 	MEM_FREE(vec_in);
@@ -48,8 +48,9 @@
 #define SALT_SIZE			BINARY_SIZE
 #define SALT_ALIGN			1
 
-#define MIN_KEYS_PER_CRYPT		1
-#define MAX_KEYS_PER_CRYPT		1
+#define SCRYPT_X			2 /* candidates interleaved per escrypt_r_x() */
+#define MIN_KEYS_PER_CRYPT		SCRYPT_X
+#define MAX_KEYS_PER_CRYPT		SCRYPT_X
 
 static struct fmt_tests tests[] = {
 	{"$7$C6..../....SodiumChloride$kBGj9fHznVYFQMEn/qDCfrDevf9YDtcDdKvEqHJLV8D", "pleaseletmein"},
@@ -383,17 +384,23 @@ static int crypt_all(int *pcount, struct db_salt *salt)
 #ifdef _OPENMP
 #pragma omp parallel for default(none) private(index) shared(count, failed, local, saved_salt, buffer)
 #endif
-	for (index = 0; index < count; index++) {
-		uint8_t *hash;
-		hash = escrypt_r(&(local[index]),
-		    (const uint8_t *)(buffer[index].key),
-		    strlen(buffer[index].key),
-		    (const uint8_t *)saved_salt,
-		    (uint8_t *)&(buffer[index].out),
-		    sizeof(buffer[index].out));
-		if (!hash) {
+	for (index = 0; index < count; index += SCRYPT_X) {
+		const uint8_t *key[SCRYPT_X];
+		size_t len[SCRYPT_X];
+		uint8_t *out[SCRYPT_X];
+		int i, n = MIN(count - index, SCRYPT_X);
+
+		for (i = 0; i < n; i++) {
+			key[i] = (const uint8_t *)(buffer[index + i].key);
+			len[i] = strlen(buffer[index + i].key);
+			out[i] = (uint8_t *)&(buffer[index + i].out);
+		}
+		if (escrypt_r_x(&(local[index / SCRYPT_X]), n, key, len,
+		    (const uint8_t *)saved_salt, out,
+		    sizeof(buffer[index].out))) {
 			failed = 1;
-			buffer[index].out[0] = 0;
+			for (i = 0; i < n; i++)
+				buffer[index + i].out[0] = 0;
 		}
 	}
 
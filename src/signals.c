@@ -61,6 +61,7 @@ volatile int event_pending = 0, event_reload = 0;
 volatile int event_abort = 0, event_save = 0, event_status = 0;
 volatile int event_ticksafety = 0;
 volatile int event_mpiprobe = 0, event_poll_files = 0;
+volatile int event_metrics = 0;
 
 volatile int timer_abort = 0, timer_status = 0;
 static int timer_save_interval, timer_save_value;
@@ -303,6 +304,8 @@ static void sig_handle_timer(int signum)
 	unsigned int time;
 #endif
 #ifndef BENCH_BUILD
+	if (options.flags & FLG_METRICS)
+		event_metrics = event_pending = 1;
 #if OS_TIMER
 	/* Some stuff only done every few seconds */
 	if (timer_save_interval < 4 ||
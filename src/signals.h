@@ -40,6 +40,7 @@ extern volatile int event_ticksafety;	/* System time in ticks may overflow */
 extern volatile int event_mpiprobe;	/* MPI probe for messages requested */
 #endif
 extern volatile int event_poll_files;	/* Every 3 s, poll pause/abort files */
+extern volatile int event_metrics;	/* Every 1 s, serve metrics socket */
 extern volatile int aborted_by_timer;	/* Session was aborted by timer */
 
 /* --max-run-time timer */
@@ -2702,3 +2702,52 @@ void SIMDSHA512body(vtype* data, ARCH_WORD_64 *out, ARCH_WORD_64 *reload_state,
 }
 
 #endif /* SIMD_PARA_SHA512 */
+
+#if SIMD_COEF_32
+/*
+ * Base-16 of 'words' little endian 32 bit words of interleaved SIMD output
+ * (the MD4/MD5 crypt_key layout), written as interleaved input words: word k
+ * of every lane becomes words 2k and 2k+1 of that lane.  This is the step
+ * between the two crypts of md5(md5($p)) and friends, and doing a vector of
+ * lanes at a time beats walking the itoa16_w2[] table one lane at a time.
+ * Only 32 bit and/or/add/shift are used, so every vtype we have can do it.
+ */
+void SIMDhex_out_32(ARCH_WORD_32 *out, const ARCH_WORD_32 *in,
+                    unsigned int words, int upper)
+{
+	const vtype m0f = vset1_epi32(0x0f0f0f0f);
+	const vtype m01 = vset1_epi32(0x01010101);
+	const vtype even = vset1_epi32(0x00ff00ff);
+	const vtype odd = vset1_epi32(0xff00ff00);
+	const vtype lo16 = vset1_epi32(0x0000ffff);
+	const vtype hi16 = vset1_epi32(0xffff0000);
+	const vtype zero = vset1_epi32(0x30303030);
+	const vtype over9 = vset1_epi32(0x76767676);
+	unsigned int k;
+
+	for (k = 0; k < words; k++) {
+		vtype v = vload((vtype*)&in[k*VS32]);
+		vtype hi = vand(vsrli_epi32(v, 4), m0f);
+		vtype lo = vand(v, m0f);
+		/* nibbles of bytes 0,2 and of bytes 1,3, high nibble first */
+		vtype u = vor(vand(hi, even), vand(vslli_epi32(lo, 8), odd));
+		vtype w = vor(vand(vsrli_epi32(hi, 8), even), vand(lo, odd));
+		vtype n[2];
+		unsigned int j;
+
+		n[0] = vor(vand(u, lo16), vslli_epi32(w, 16));
+		n[1] = vor(vsrli_epi32(u, 16), vand(w, hi16));
+		for (j = 0; j < 2; j++) {
+			/* 0x01 in each byte holding 10..15 (0x76+10 sets bit 7) */
+			vtype a = vand(vsrli_epi32(vadd_epi32(n[j], over9), 7), m01);
+
+			/* '9'+1 to 'A' is 7, to 'a' is 39 */
+			a = vor(vor(a, vslli_epi32(a, 1)), vslli_epi32(a, 2));
+			if (!upper)
+				a = vor(a, vslli_epi32(vand(a, m01), 5));
+			vstore((vtype*)&out[(2*k+j)*VS32],
+			       vadd_epi32(vadd_epi32(n[j], zero), a));
+		}
+	}
+}
+#endif
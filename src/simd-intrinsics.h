@@ -134,6 +134,11 @@ void sha512_unreverse(ARCH_WORD_64 *hash);
 
 #endif
 
+#ifdef SIMD_COEF_32
+// base-16 of interleaved LE output words, into interleaved input words
+void SIMDhex_out_32(ARCH_WORD_32 *out, const ARCH_WORD_32 *in, unsigned int words, int upper);
+#endif
+
 #undef vtype /* void */
 
 #endif // __JTR_SSE_INTRINSICS_H__
@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "stdint.h"
 #include "misc.h"
 #include "params.h"
 #include "common.h"
@@ -34,6 +35,7 @@ static int rec_rule;
 static struct db_main *single_db;
 static int rule_number, rule_count;
 static int length, key_count;
+static unsigned int hash_size;
 static struct db_keys *guessed_keys;
 static struct rpp_context *rule_ctx;
 
@@ -71,14 +73,16 @@ static double get_progress(void)
 
 static void single_alloc_keys(struct db_keys **keys)
 {
-	int hash_size = sizeof(struct db_keys_hash) +
+	int list_size = sizeof(struct db_keys_hash) +
 		sizeof(struct db_keys_hash_entry) * (key_count - 1);
 
 	if (!*keys) {
 		*keys = mem_alloc_tiny(
 			sizeof(struct db_keys) - 1 + length * key_count,
 			MEM_ALIGN_WORD);
-		(*keys)->hash = mem_alloc_tiny(hash_size, MEM_ALIGN_WORD);
+		(*keys)->hash = mem_alloc_tiny(list_size, MEM_ALIGN_WORD);
+		(*keys)->hash->hash = mem_alloc_tiny(sizeof(short) * hash_size,
+			MEM_ALIGN_WORD);
 	}
 
 	(*keys)->count = (*keys)->count_from_guesses = 0;
@@ -86,12 +90,15 @@ static void single_alloc_keys(struct db_keys **keys)
 	(*keys)->have_words = 1; /* assume yes; we'll see for real later */
 	(*keys)->rule = rule_number;
 	(*keys)->lock = 0;
-	memset((*keys)->hash, -1, hash_size);
+	memset((*keys)->hash->list, -1,
+		sizeof(struct db_keys_hash_entry) * key_count);
+	memset((*keys)->hash->hash, -1, sizeof(short) * hash_size);
 }
 
 static void single_init(void)
 {
 	struct db_salt *salt;
+	int max_keys, buffer_size;
 
 	log_event("Proceeding with \"single crack\" mode");
 
@@ -113,14 +120,36 @@ static void single_init(void)
 	key_count = single_db->format->params.min_keys_per_crypt;
 	if (key_count < SINGLE_HASH_MIN)
 		key_count = SINGLE_HASH_MIN;
+
+/*
+ * Each salt's buffer goes to crypt_all() on its own, so buffering only
+ * min_keys_per_crypt keys leaves formats that scale max_keys_per_crypt up
+ * (OpenMP, OpenCL) running mostly empty batches.  Buffer up to
+ * max_keys_per_crypt keys per salt instead, as long as all salts' buffers
+ * together stay within SingleMaxBufferSize MiB.
+ */
+	if ((buffer_size = cfg_get_int(SECTION_OPTIONS, NULL,
+	                               "SingleMaxBufferSize")) < 0)
+		buffer_size = SINGLE_MAX_BUFFER_SIZE;
+	max_keys = single_db->format->params.max_keys_per_crypt;
+	if (options.force_maxkeys && max_keys > options.force_maxkeys)
+		max_keys = options.force_maxkeys;
+	while (max_keys > key_count &&
+	       ((uint64_t)single_db->salt_count * max_keys * length >> 20) >=
+	       buffer_size)
+		max_keys >>= 1;
+	if (max_keys > key_count)
+		key_count = max_keys;
+
 /*
- * We use "short" for buffered key indices and "unsigned short" for buffered
- * key offsets - make sure these don't overflow.
+ * We use "short" for buffered key indices - make sure these don't overflow.
  */
 	if (key_count > 0x8000)
 		key_count = 0x8000;
-	while (key_count > 0xffff / length + 1)
-		key_count >>= 1;
+
+	hash_size = SINGLE_HASH_SIZE;
+	while (hash_size < key_count)
+		hash_size <<= 1;
 
 	if (rpp_init(rule_ctx, options.activesinglerules)) {
 		log_event("! No \"%s\" mode rules found",
@@ -196,7 +225,7 @@ static MAYBE_INLINE int single_key_hash(char *key)
 #endif
 
 out_and:
-	hash &= SINGLE_HASH_SIZE - 1;
+	hash &= hash_size - 1;
 out:
 	return hash;
 }
@@ -213,7 +242,7 @@ static int single_add_key(struct db_salt *salt, char *key, int is_from_guesses)
 	if ((index = keys->hash->hash[new_hash = single_key_hash(key)]) >= 0)
 	do {
 		entry = &keys->hash->list[index];
-		if (!strncmp(key, &keys->buffer[entry->offset], length))
+		if (!strncmp(key, &keys->buffer[index * length], length))
 			return 0;
 	} while ((index = entry->next) >= 0);
 
@@ -237,7 +266,6 @@ static int single_add_key(struct db_salt *salt, char *key, int is_from_guesses)
 	index = keys->hash->hash[new_hash];
 	entry = &keys->hash->list[keys->count];
 	entry->next = index;
-	entry->offset = keys->ptr - keys->buffer;
 	keys->hash->hash[new_hash] = keys->count;
 
 	strnfcpy(keys->ptr, key, length);
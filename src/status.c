@@ -20,6 +20,18 @@
 #if HAVE_SYS_TIMES_H
 #include <sys/times.h>
 #endif
+#if (!AC_BUILT || HAVE_SYS_SOCKET_H) && !_MSC_VER && !__MINGW32__ && \
+	!__DJGPP__
+#define STATUS_METRICS			1
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#else
+#define STATUS_METRICS			0
+#endif
 
 #include "times.h"
 
@@ -30,6 +42,8 @@
 #include "misc.h"
 #include "math.h"
 #include "params.h"
+#include "memory.h"
+#include "logger.h"
 #include "cracker.h"
 #include "options.h"
 #include "status.h"
@@ -38,6 +52,9 @@
 #include "unicode.h"
 #include "signals.h"
 #include "mask.h"
+#include "loader.h"
+#include "recovery.h"
+#include "john.h"
 #ifdef HAVE_MPI
 #include "john-mpi.h"
 #endif
@@ -50,6 +67,11 @@ static char* timeFmt = NULL;
 static char* timeFmt24 = NULL;
 static int showcand;
 double (*status_get_progress)(void) = NULL;
+#if STATUS_METRICS
+static int metrics_fd = -1;
+static char *metrics_path;
+static struct db_main *metrics_db;
+#endif
 
 static clock_t get_time(void)
 {
@@ -491,4 +513,264 @@ void status_print(void)
 #else
 		status_print_cracking(percent_value);
 #endif
+
+	if (!(options.flags & FLG_STDOUT))
+		crk_print_stats();
+}
+
+#if STATUS_METRICS
+/*
+ * The socket of node is NAME.sock for a session NAME (NAME.node.sock for
+ * the --fork children), or PATH (PATH.node) if one was given.
+ */
+static char *status_metrics_name(unsigned int node, int child)
+{
+	static char name[sizeof(((struct sockaddr_un *)0)->sun_path) + 1];
+	char *base = options.metrics_socket;
+	int len;
+
+	if (base) {
+		if (child)
+			len = snprintf(name, sizeof(name), "%s.%u", base, node);
+		else
+			len = snprintf(name, sizeof(name), "%s", base);
+	} else {
+		int n = strlen(rec_name) - (sizeof(RECOVERY_SUFFIX) - 1);
+		char suffix[16];
+
+		if (n > 0 && !strcmp(rec_name + n, RECOVERY_SUFFIX)) {
+/* A child's rec_name already has the node number in it */
+			if (child && john_main_process)
+				sprintf(suffix, ".%u", node);
+			else
+				suffix[0] = 0;
+			len = snprintf(name, sizeof(name), "%.*s%s.sock",
+			    n, rec_name, suffix);
+		} else
+			len = snprintf(name, sizeof(name), "%s.sock",
+			    rec_name);
+	}
+
+	if (len < 0 || len >= (int)sizeof(name) - 1)
+		return NULL;
+
+	return name;
+}
+
+/* Room for any socket name, quoted and with every character escaped */
+#define METRICS_JSON_NAME_SIZE \
+	(6 * sizeof(((struct sockaddr_un *)0)->sun_path) + 3)
+
+/* Same escaping as bench.c's json_string(), into out */
+static char *status_json_string(char *out, const char *s)
+{
+	char *p = out;
+
+	*p++ = '"';
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\') {
+			*p++ = '\\';
+			*p++ = *s;
+		} else if ((unsigned char)*s < 0x20)
+			p += sprintf(p, "\\u%04x", (unsigned char)*s);
+		else
+			*p++ = *s;
+	}
+	*p++ = '"';
+	*p = 0;
+
+	return out;
+}
+
+static void status_metrics_done(void)
+{
+	if (metrics_fd < 0)
+		return;
+
+	close(metrics_fd);
+	metrics_fd = -1;
+	unlink(metrics_path);
+}
+
+void status_metrics_init(struct db_main *db)
+{
+	struct sockaddr_un addr;
+	char *name;
+	int child;
+
+	metrics_db = db;
+
+	if (!(options.flags & FLG_METRICS) || metrics_fd >= 0)
+		return;
+
+#ifndef HAVE_MPI
+	child = options.fork && !john_main_process;
+#else
+	child = !john_main_process && options.node_min;
+#endif
+	if (!(name = status_metrics_name(options.node_min, child))) {
+		fprintf(stderr, "Metrics socket name too long\n");
+		error();
+	}
+	metrics_path = str_alloc_copy(name);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strnzcpy(addr.sun_path, metrics_path, sizeof(addr.sun_path));
+
+/* A stale socket from a crashed session would make bind() fail */
+	unlink(metrics_path);
+
+	if ((metrics_fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		pexit("socket");
+	if (bind(metrics_fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    listen(metrics_fd, 16)) {
+		fprintf(stderr, "%s: %s\n", metrics_path, strerror(errno));
+		error();
+	}
+	if (fcntl(metrics_fd, F_SETFL,
+	    fcntl(metrics_fd, F_GETFL) | O_NONBLOCK))
+		pexit("fcntl");
+
+	atexit(status_metrics_done);
+
+	log_event("Metrics socket: %.100s", metrics_path);
+}
+
+static double status_get_count(int64 *c, unsigned int c_ehi)
+{
+	return ((double)c_ehi * 4294967296.0 + c->hi) * 4294967296.0 + c->lo;
+}
+
+static int status_metrics_format(char *buf, size_t size)
+{
+	unsigned int time = status_get_time();
+	double secs, percent = -1;
+	char s_progress[32] = "null", s_eta[32] = "null";
+	char s_name[METRICS_JSON_NAME_SIZE];
+	int64 g;
+	size_t n;
+
+	secs = (double)(get_time() - status.start_time) / clk_tck +
+		status_restored_time;
+	if (secs <= 0)
+		secs = 1;
+
+	if (options.flags & FLG_STATUS_CHK)
+		percent = status.progress;
+	else
+	if (status_get_progress)
+		percent = status_get_progress();
+	if (percent >= 0)
+		sprintf(s_progress, "%.2f", percent);
+	if (percent > 0 && percent < 100)
+		sprintf(s_eta, "%.0f", time * (100 / percent - 1));
+
+	g.lo = status.guess_count; g.hi = 0;
+
+	n = snprintf(buf, size,
+	    "{\"socket\": %s, \"node\": %u, \"pid\": %u, "
+	    "\"time\": %u, \"progress\": %s, \"eta\": %s, "
+	    "\"guesses\": %u, \"candidates\": %.0f, \"crypts\": %.0f, "
+	    "\"combinations\": %.0f, \"g/s\": %.3f, \"p/s\": %.0f, "
+	    "\"c/s\": %.0f, \"C/s\": %.0f",
+	    status_json_string(s_name, metrics_path),
+	    options.node_min, (unsigned int)getpid(),
+	    time, s_progress, s_eta, status.guess_count,
+	    status_get_count(&status.cands, 0),
+	    status_get_count(&status.crypts, 0),
+	    status_get_count(&status.combs, status.combs_ehi),
+	    status_get_count(&g, 0) / secs,
+	    status_get_count(&status.cands, 0) / secs,
+	    status_get_count(&status.crypts, 0) / secs,
+	    status_get_count(&status.combs, status.combs_ehi) / secs);
+
+	if (metrics_db && n < size)
+		n += snprintf(buf + n, size - n,
+		    ", \"hashes_left\": %d, \"salts_left\": %d",
+		    metrics_db->password_count, metrics_db->salt_count);
+
+#if defined(HAVE_CUDA) || defined(HAVE_OPENCL)
+	if (n < size) {
+		int i, first = 1;
+
+		n += snprintf(buf + n, size - n, ", \"gpus\": [");
+		for (i = 0; i < MAX_GPU_DEVICES &&
+			     gpu_device_list[i] != -1 && n < size; i++) {
+			int dev = gpu_device_list[i];
+			int fan, temp, util, cl, ml;
+
+			if (!dev_get_temp[dev])
+				continue;
+			fan = temp = util = cl = ml = -1;
+			dev_get_temp[dev](temp_dev_id[dev],
+			                  &temp, &fan, &util, &cl, &ml);
+			n += snprintf(buf + n, size - n,
+			    "%s{\"device\": %d, \"temp\": %d, \"fan\": %d, "
+			    "\"util\": %d}", first ? "" : ", ",
+			    dev, temp, fan, util);
+			first = 0;
+		}
+		if (n < size)
+			n += snprintf(buf + n, size - n, "]");
+	}
+#endif
+
+/* Our --fork children serve their own sockets, tell where to find them */
+#ifndef HAVE_MPI
+	if (options.fork && john_main_process && n < size) {
+		int i;
+
+		n += snprintf(buf + n, size - n, ", \"children\": [");
+		for (i = 1; i < options.fork && n < size; i++) {
+			char *child = status_metrics_name(options.node_min + i,
+			    1);
+
+			n += snprintf(buf + n, size - n, "%s%s",
+			    i > 1 ? ", " : "",
+			    child ? status_json_string(s_name, child) : "null");
+		}
+		if (n < size)
+			n += snprintf(buf + n, size - n, "]");
+	}
+#endif
+
+	if (n < size)
+		n += snprintf(buf + n, size - n, "}\n");
+
+	return n < size ? n : -1;
+}
+
+void status_metrics_poll(void)
+{
+	char buf[4096];
+	int fd, len = -1, clients = 0;
+
+	if (metrics_fd < 0)
+		return;
+
+/* Don't let a flood of clients hold up cracking */
+	while (clients++ < 16 && (fd = accept(metrics_fd, NULL, NULL)) >= 0) {
+		if (len < 0 && (len = status_metrics_format(buf, sizeof(buf))) < 0)
+			len = 0;
+#ifdef MSG_NOSIGNAL
+		if (send(fd, buf, len, MSG_NOSIGNAL)) {}
+#else
+		if (write(fd, buf, len)) {}
+#endif
+		close(fd);
+	}
 }
+#else
+void status_metrics_init(struct db_main *db)
+{
+	if (options.flags & FLG_METRICS) {
+		fprintf(stderr, "Metrics socket not supported on this system\n");
+		error();
+	}
+}
+
+void status_metrics_poll(void)
+{
+}
+#endif
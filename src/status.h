@@ -93,4 +93,17 @@ extern unsigned int status_get_time(void);
  */
 extern void status_print(void);
 
+/*
+ * Opens this process' --metrics-socket, if requested, and remembers the
+ * database to report hashes and salts left for.
+ */
+struct db_main;
+extern void status_metrics_init(struct db_main *db);
+
+/*
+ * Answers any clients waiting on the metrics socket with a one-line JSON
+ * snapshot of the current status.  Called from the cracker once a second.
+ */
+extern void status_metrics_poll(void);
+
 #endif
@@ -28,6 +28,9 @@
  */
 
 #include <string.h>
+#if __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "common.h"
 #include "arch.h"
@@ -114,6 +117,53 @@ static const UTF32 halfMask = 0x3FFUL;
 #define UNI_SUR_LOW_START   (UTF32)0xDC00
 #define UNI_SUR_LOW_END     (UTF32)0xDFFF
 
+/*
+ * Widen 7-bit characters to UTF-16LE eight at a time, for as long as a whole
+ * block of eight is below 0x80 (and, with stop_at_nul, has no NUL) and fits
+ * in 'len'.  0x00-0x7f map to themselves in UTF-8 and in every codepage we
+ * have, so the callers just carry on with their own loop from the returned
+ * count; most candidates never get there.
+ */
+static MAYBE_INLINE unsigned int ascii_to_utf16(UTF16 *dst, const UTF8 *src,
+                                                unsigned int len,
+                                                int stop_at_nul)
+{
+	unsigned int i = 0;
+#if ARCH_LITTLE_ENDIAN
+	const uint64_t hi = 0x8080808080808080ULL;
+	const uint64_t lo = 0x0101010101010101ULL;
+
+	for (; i + 8 <= len; i += 8) {
+		uint64_t v;
+
+		memcpy(&v, &src[i], 8);
+		if ((v & hi) || (stop_at_nul && ((v - lo) & ~v & hi)))
+			break;
+#if __SSE2__
+		_mm_storeu_si128((__m128i*)&dst[i],
+		                 _mm_unpacklo_epi8(_mm_loadl_epi64((__m128i*)&src[i]),
+		                                   _mm_setzero_si128()));
+#else
+		{
+			uint64_t w[2];
+			uint32_t h;
+			unsigned int j;
+
+			for (j = 0; j < 2; j++) {
+				h = (uint32_t)(v >> (32 * j));
+				w[j] = (uint64_t)(h & 0xff) |
+					(uint64_t)(h & 0xff00) << 8 |
+					(uint64_t)(h & 0xff0000) << 16 |
+					(uint64_t)(h & 0xff000000) << 24;
+			}
+			memcpy(&dst[i], w, 16);
+		}
+#endif
+	}
+#endif
+	return i;
+}
+
 /*
  * Convert UTF-8 string to UTF-16LE, regardless of arch
  *
@@ -134,6 +184,17 @@ int utf8_to_utf16(UTF16 *target, unsigned int len, const UTF8 *source,
 	UTF32 ch;
 	unsigned int extraBytesToRead;
 
+	/* Leading ASCII, short of the last slot (the loop below checks that) */
+	if (len && (extraBytesToRead = ascii_to_utf16(target, source,
+	        sourceLen < len ? sourceLen : len - 1, 1))) {
+		target += extraBytesToRead;
+		source += extraBytesToRead;
+		if (source < sourceEnd && *source == 0) {
+			*target = 0;
+			return (target - targetStart);
+		}
+	}
+
 	while (source < sourceEnd) {
 		if (*source < 0xC0) {
 #if ARCH_LITTLE_ENDIAN
@@ -350,7 +411,10 @@ int enc_to_utf16(UTF16 *dst, unsigned int maxdstlen, const UTF8 *src,
 		if (trunclen > maxdstlen)
 			trunclen = maxdstlen;
 
-		for (i = 0; i < trunclen; i++) {
+		i = ascii_to_utf16(dst, src, trunclen, 0);
+		dst += i;
+		src += i;
+		for (; i < trunclen; i++) {
 #if ARCH_LITTLE_ENDIAN
 			*dst++ = CP_to_Unicode[*src++];
 #else
@@ -380,7 +444,10 @@ static inline int cp_to_utf16(UTF16 *dst, unsigned int maxdstlen,
 	if (trunclen > maxdstlen)
 		trunclen = maxdstlen;
 
-	for (i = 0; i < trunclen; i++) {
+	i = ascii_to_utf16(dst, src, trunclen, 0);
+	dst += i;
+	src += i;
+	for (; i < trunclen; i++) {
 #if ARCH_LITTLE_ENDIAN
 		*dst++ = CP_to_Unicode[*src++];
 #else
@@ -23,6 +23,26 @@
  *           params.h.  The default is 24 or 25.  valid range from 13 to 25.
  *           25 will use a 2GB memory buffer, and 33 entry million hash table
  *           Each number doubles size.
+ * -part=num Partitioned mode for inputs too big to keep in memory.  The
+ *           input (and any -ex_file) is split into num temporary bucket
+ *           files by a hash of each line, so all copies of a line end up
+ *           in the same bucket.  The buckets are then deduped in memory,
+ *           in parallel (OpenMP).  Only one bucket per thread needs to fit
+ *           in memory, and the data is read and written once to get it
+ *           into the buckets and once more to get it out.  Output is
+ *           grouped by bucket unless -keep-order is also given.  All the
+ *           buckets are open at once, so num is bounded by the open files
+ *           limit (ulimit -n).
+ * -keep-order  With -part, output unique lines in order of their first
+ *           occurrence in the input (costs an extra merge pass).
+ * -pot=FILE Compact a .pot file in place: lines are compared with their
+ *           ciphertext reduced the way john writes it (ldr_pot_source()),
+ *           using -part= buckets (sized from -mem= unless given) and
+ *           -keep-order.  The result goes to FILE.compact.PID first and is
+ *           then copied back under the same lock john uses to append to the
+ *           pot, together with anything appended in the meantime, so this
+ *           is safe to run while sessions are cracking.
+ * -sort     With -pot, group the lines by format tag ("$NT$" etc).
  */
 
 #if AC_BUILT
@@ -31,6 +51,9 @@
 #define _POSIX_SOURCE /* for fdopen(3) */
 #endif
 
+#define NEED_OS_FLOCK
+#include "os.h"
+
 #include <stdio.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -38,17 +61,32 @@
 #include <fcntl.h>
 #endif
 #include <string.h>
+#if !AC_BUILT || HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#if !AC_BUILT || HAVE_SYS_FILE_H
+#include <sys/file.h>
+#endif
+#include <errno.h>
+#if !defined(__DJGPP__) && !defined(__BEOS__) && !defined(__MINGW32__) && !defined (_MSC_VER)
+#include <sys/resource.h>
+#endif
 #ifdef _MSC_VER
 #include <io.h>
 #pragma warning ( disable : 4996 )
 #define fdopen _fdopen
 #endif
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "arch.h"
 #include "misc.h"
 #include "params.h"
 #include "memory.h"
 #include "jumbo.h"
+#include "loader.h"
 #include "memdbg.h"
 
 #define ENTRY_END_HASH			0xFFFFFFFF /* also hard-coded */
@@ -65,6 +103,17 @@ static FILE *output;
 static FILE *use_to_unique_but_not_add;
 static int do_not_unique_against_self=0;
 
+static unsigned int part_count;
+static int keep_order;
+
+static char *pot_name;
+static int pot_sort;
+static long long pot_size;
+
+/* What to remove if we exit (through error() or pexit()) half way */
+static char *part_base;
+static char *pot_temp;
+
 long long totLines=0,written_lines=0;
 int verbose=0, cut_len=0, LM=0;
 unsigned int vUNIQUE_HASH_LOG=UNIQUE_HASH_LOG, vUNIQUE_HASH_SIZE=UNIQUE_HASH_SIZE, vUNIQUE_BUFFER_SIZE=UNIQUE_BUFFER_SIZE;
@@ -330,8 +379,10 @@ static void unique_init(char *name)
 {
 	int fd;
 
-	buffer.hash = mem_alloc(vUNIQUE_HASH_SIZE * sizeof(unsigned int));
-	buffer.data = mem_alloc(vUNIQUE_BUFFER_SIZE);
+	if (!part_count) {
+		buffer.hash = mem_alloc(vUNIQUE_HASH_SIZE * sizeof(unsigned int));
+		buffer.data = mem_alloc(vUNIQUE_BUFFER_SIZE);
+	}
 
 #if defined (_MSC_VER) || defined(__MINGW32__)
 	fd = open(name, O_RDWR | O_CREAT | O_EXCL | O_BINARY, 0600);
@@ -365,9 +416,630 @@ static void unique_done(void)
 	if (fclose(output)) pexit("fclose");
 }
 
+/*
+ * Partitioned (-part=N) mode.
+ *
+ * Bucket records are the line followed by '\n'. With -keep-order, each
+ * record is prefixed by the 64-bit number of the input line it came from,
+ * which is also how the surviving lines are merged back in the end.
+ */
+#define PART_BASIS_BUCKET		0x811c9dc5
+#define PART_BASIS_TABLE		0x9747b28c
+
+typedef unsigned long long part_seq_t;
+
+static unsigned int part_hash(const char *line, unsigned int hash)
+{
+	while (*line) {
+		hash ^= (unsigned char)*line++;
+		hash *= 0x01000193;
+	}
+	return hash;
+}
+
+static void part_name(char *name, size_t size, char *base, char kind,
+                      unsigned int n)
+{
+	snprintf(name, size, "%s.%c%u", base, kind, n);
+}
+
+static FILE *part_open(char *base, char kind, unsigned int n, char *mode)
+{
+	char name[PATH_BUFFER_SIZE];
+	FILE *fp;
+
+	part_name(name, sizeof(name), base, kind, n);
+	if (!(fp = fopen(name, mode)))
+		pexit("fopen: %s", name);
+	return fp;
+}
+
+static void part_remove(char *base, char kind, unsigned int n)
+{
+	char name[PATH_BUFFER_SIZE];
+
+	part_name(name, sizeof(name), base, kind, n);
+	unlink(name);
+}
+
+/*
+ * Longest record we merge back.  A pot line is at most MAX_CIPHERTEXT_SIZE
+ * of ciphertext, the separator and a $HEX$ encoded plaintext.
+ */
+#define PART_LINE_SIZE			(2 * LINE_BUFFER_SIZE)
+
+/* Pot line with the ciphertext in the form john writes it */
+static char *pot_canon(char *line, char *buf)
+{
+	char ct_buf[LINE_BUFFER_SIZE + 1];
+	const char *ct;
+	char *sep;
+
+	if ((sep = strchr(line, ':'))) {
+		*sep = 0;
+		ct = ldr_pot_source(line, ct_buf);
+		*sep = ':';
+		if (ct != line) {
+			snprintf(buf, PART_LINE_SIZE, "%s%s", ct, sep);
+			line = buf;
+		}
+	}
+	if (strlen(line) >= PART_LINE_SIZE - 1) {
+		fprintf(stderr, "Error, pot line too long, not compacting: "
+		        "%.40s...\n", line);
+		error();
+	}
+	return line;
+}
+
+/* Length of the format tag ("$NT$") a line starts with, if any */
+static size_t pot_tag_len(const char *line)
+{
+	const char *end;
+
+	if (*line != '$' || !(end = strchr(line + 1, '$')))
+		return 0;
+	return end - line + 1;
+}
+
+static int pot_tag_cmp(const char *a, const char *b)
+{
+	size_t alen = pot_tag_len(a), blen = pot_tag_len(b);
+	int cmp = memcmp(a, b, alen < blen ? alen : blen);
+
+	if (cmp)
+		return cmp;
+	return (alen > blen) - (alen < blen);
+}
+
+static void part_put(FILE **bucket, char *line, part_seq_t seq)
+{
+	FILE *fp = bucket[part_hash(line, PART_BASIS_BUCKET) % part_count];
+
+	if (keep_order && fwrite(&seq, sizeof(seq), 1, fp) != 1)
+		pexit("fwrite");
+	if (fputs(line, fp) < 0 || putc('\n', fp) < 0)
+		pexit("fwrite");
+}
+
+/* Pass 1: split the input (and -ex_file) into buckets */
+static void part_split(char *base)
+{
+	char line[LINE_BUFFER_SIZE];
+	FILE **bucket;
+	unsigned int n;
+	part_seq_t seq = 0;
+
+	bucket = mem_alloc(part_count * sizeof(FILE*));
+
+	if (use_to_unique_but_not_add) {
+		for (n = 0; n < part_count; n++)
+			bucket[n] = part_open(base, 'x', n, "wb");
+		while (fgetl(line, sizeof(line), use_to_unique_but_not_add)) {
+			if (cut_len) line[cut_len] = 0;
+			part_put(bucket, line, 0);
+		}
+		for (n = 0; n < part_count; n++)
+			if (fclose(bucket[n])) pexit("fclose");
+	}
+
+	for (n = 0; n < part_count; n++)
+		bucket[n] = part_open(base, 'b', n, "wb");
+	if (pot_name)
+	while (jtr_ftell64(fpInput) < pot_size) {
+		char canon[PART_LINE_SIZE], *ex_line;
+
+		if (!(ex_line = fgetll(line, sizeof(line), fpInput)))
+			break;
+		++totLines;
+		part_put(bucket, pot_canon(ex_line, canon), seq++);
+		if (ex_line != line)
+			MEM_FREE(ex_line);
+	}
+	else
+	while (fgetl(line, sizeof(line), fpInput)) {
+		char LM_Buf[8];
+
+		*LM_Buf = 0;
+		if (LM) {
+			if (strlen(line) > 7) {
+				strncpy(LM_Buf, &line[7], 7);
+				LM_Buf[7] = 0;
+				upcase(LM_Buf);
+				++totLines;
+			}
+			line[7] = 0;
+			upcase(line);
+		} else if (cut_len) line[cut_len] = 0;
+		++totLines;
+		part_put(bucket, line, seq++);
+		if (*LM_Buf)
+			part_put(bucket, LM_Buf, seq++);
+
+		if (verbose && !(totLines & 0xfffff))
+			printf("\rTotal lines read "LLu"\r", totLines);
+	}
+	if (ferror(fpInput)) pexit("fgets");
+	for (n = 0; n < part_count; n++)
+		if (fclose(bucket[n])) pexit("fclose");
+
+	MEM_FREE(bucket);
+}
+
+static long long part_size(FILE *fp)
+{
+	long long len;
+
+	if (jtr_fseek64(fp, 0, SEEK_END) < 0) pexit("fseek");
+	len = jtr_ftell64(fp);
+	if (len < 0) pexit("ftell");
+	if (jtr_fseek64(fp, 0, SEEK_SET) < 0) pexit("fseek");
+	return len;
+}
+
+/* Reads a whole bucket file into memory, turning '\n' into NUL */
+static unsigned int part_read(FILE *fp, char *data, size_t len)
+{
+	size_t hdr = keep_order ? sizeof(part_seq_t) : 0;
+	unsigned int records = 0;
+	char *p = data, *end = data + len;
+
+	if (len && fread(data, len, 1, fp) != 1)
+		pexit("fread");
+	fclose(fp);
+
+	while (p < end) {
+		p = memchr(p + hdr, '\n', end - p - hdr);
+		*p++ = 0;
+		records++;
+	}
+	return records;
+}
+
+/*
+ * Open addressing set of offsets into a loaded bucket. Returns 1 if the
+ * string was already there, otherwise adds it.
+ */
+static int part_seen(unsigned int *table, unsigned int mask, char *data,
+                     unsigned int offset, size_t hdr)
+{
+	char *line = &data[offset + hdr];
+	unsigned int i = part_hash(line, PART_BASIS_TABLE) & mask;
+
+	while (table[i] != ENTRY_END_HASH) {
+		if (!strcmp(line, &data[table[i] + hdr]))
+			return 1;
+		i = (i + 1) & mask;
+	}
+	table[i] = offset;
+	return 0;
+}
+
+/* -pot -sort: order by format tag, then by line number */
+static int part_rec_cmp(const void *a, const void *b)
+{
+	const char *x = *(const char**)a, *y = *(const char**)b;
+	part_seq_t xs, ys;
+	int cmp;
+
+	if ((cmp = pot_tag_cmp(x + sizeof(part_seq_t), y + sizeof(part_seq_t))))
+		return cmp;
+	memcpy(&xs, x, sizeof(xs));
+	memcpy(&ys, y, sizeof(ys));
+	return (xs > ys) - (xs < ys);
+}
+
+/* Pass 2: dedup one bucket */
+static void part_dedup(char *base, unsigned int n)
+{
+	size_t hdr = keep_order ? sizeof(part_seq_t) : 0;
+	unsigned int records, mask, ptr, out, written = 0;
+	unsigned int *table;
+	long long size, xsize = 0;
+	FILE *fp, *xfp = NULL;
+	char *data;
+
+	fp = part_open(base, 'b', n, "rb");
+	size = part_size(fp);
+	if (use_to_unique_but_not_add) {
+		xfp = part_open(base, 'x', n, "rb");
+		xsize = part_size(xfp);
+	}
+	if (size + xsize >= 0xffffffffLL) {
+		fprintf(stderr, "Error, bucket %u is "LLd" bytes. Use a larger "
+		        "-part= value\n", n, size + xsize);
+		error();
+	}
+
+	/* The -ex_file lines are loaded after the input lines */
+	data = mem_alloc(size + xsize + 1);
+	records = part_read(fp, data, size);
+	if (xfp)
+		records += part_read(xfp, &data[size], xsize);
+
+	mask = 1;
+	while (mask < 2 * records)
+		mask <<= 1;
+	table = mem_alloc(mask * sizeof(unsigned int));
+	memset(table, 0xff, mask * sizeof(unsigned int));
+	mask--;
+
+	/* ... but go into the table first, we never write those */
+	for (ptr = size; ptr < size + xsize;
+	     ptr += strlen(&data[ptr + hdr]) + hdr + 1)
+		part_seen(table, mask, data, ptr, hdr);
+
+	/* Compact the survivors to the start of the buffer, in order */
+	out = 0;
+	for (ptr = 0; ptr < size; ) {
+		unsigned int len = strlen(&data[ptr + hdr]) + hdr;
+
+		if (!part_seen(table, mask, data, ptr, hdr)) {
+			/* The table must keep pointing at the string */
+			if (out != ptr) {
+				unsigned int i = part_hash(&data[ptr + hdr],
+				                           PART_BASIS_TABLE) & mask;
+
+				while (table[i] != ptr)
+					i = (i + 1) & mask;
+				memmove(&data[out], &data[ptr], len + 1);
+				table[i] = out;
+			}
+			out += len + 1;
+			written++;
+		}
+		ptr += len + 1;
+	}
+	MEM_FREE(table);
+
+	for (ptr = 0; ptr < out; ptr++) {
+		ptr += hdr + strlen(&data[ptr + hdr]);
+		data[ptr] = '\n';
+	}
+
+	if (keep_order && pot_sort) {
+		char **rec = mem_alloc((written + 1) * sizeof(char*));
+		unsigned int i = 0;
+
+		for (ptr = 0; ptr < out; ptr = strchr(&data[ptr + hdr], '\n') -
+		     data + 1)
+			rec[i++] = &data[ptr];
+		qsort(rec, written, sizeof(char*), part_rec_cmp);
+
+		fp = part_open(base, 'r', n, "wb");
+		for (i = 0; i < written; i++) {
+			size_t len = strchr(rec[i] + hdr, '\n') - rec[i] + 1;
+
+			if (fwrite(rec[i], len, 1, fp) != 1)
+				pexit("fwrite");
+		}
+		if (fclose(fp)) pexit("fclose");
+		MEM_FREE(rec);
+	} else
+	if (keep_order) {
+		fp = part_open(base, 'r', n, "wb");
+
+		if (out && fwrite(data, out, 1, fp) != 1)
+			pexit("fwrite");
+		if (fclose(fp)) pexit("fclose");
+	} else {
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+		{
+			if (out && fwrite(data, out, 1, output) != 1)
+				pexit("fwrite");
+		}
+	}
+#ifdef _OPENMP
+#pragma omp atomic
+#endif
+	written_lines += written;
+
+	MEM_FREE(data);
+	part_remove(base, 'b', n);
+	if (use_to_unique_but_not_add)
+		part_remove(base, 'x', n);
+}
+
+/* Pass 3 (-keep-order only): merge the bucket results on line number */
+struct part_head {
+	FILE *fp;
+	part_seq_t seq;
+	char line[PART_LINE_SIZE];
+};
+
+/* Whether a goes after b in the output */
+static int part_after(struct part_head *a, struct part_head *b)
+{
+	int cmp;
+
+	if (pot_sort && (cmp = pot_tag_cmp(a->line, b->line)))
+		return cmp > 0;
+	return a->seq > b->seq;
+}
+
+static int part_next(struct part_head *h)
+{
+	if (fread(&h->seq, sizeof(h->seq), 1, h->fp) != 1)
+		return 0;
+	if (!fgets(h->line, sizeof(h->line), h->fp))
+		return 0;
+	return 1;
+}
+
+static void part_merge(char *base)
+{
+	struct part_head *head;
+	unsigned int *heap, count = 0, n;
+
+	head = mem_alloc(part_count * sizeof(*head));
+	heap = mem_alloc(part_count * sizeof(*heap));
+
+	for (n = 0; n < part_count; n++) {
+		head[n].fp = part_open(base, 'r', n, "rb");
+		if (part_next(&head[n])) {
+			unsigned int i = count++;
+
+			/* sift up */
+			while (i && part_after(&head[heap[(i - 1) / 2]], &head[n])) {
+				heap[i] = heap[(i - 1) / 2];
+				i = (i - 1) / 2;
+			}
+			heap[i] = n;
+		}
+	}
+
+	while (count) {
+		unsigned int top = heap[0], i, child, last;
+
+		if (fputs(head[top].line, output) < 0)
+			pexit("fwrite");
+
+		if (part_next(&head[top]))
+			last = top;
+		else
+			last = heap[--count];
+
+		/* sift down */
+		i = 0;
+		while ((child = 2 * i + 1) < count) {
+			if (child + 1 < count &&
+			    part_after(&head[heap[child]], &head[heap[child + 1]]))
+				child++;
+			if (!part_after(&head[last], &head[heap[child]]))
+				break;
+			heap[i] = heap[child];
+			i = child;
+		}
+		if (count)
+			heap[i] = last;
+	}
+
+	for (n = 0; n < part_count; n++) {
+		fclose(head[n].fp);
+		part_remove(base, 'r', n);
+	}
+	MEM_FREE(heap);
+	MEM_FREE(head);
+}
+
+/*
+ * Descriptors besides the buckets: stdio, input, output, -ex_file, the pot,
+ * and a few spare.  part_dedup() only has three open per thread.
+ */
+#define PART_FD_SPARE			16
+
+/*
+ * How many buckets we can have open at once: the split and the merge each
+ * open all of them.  Raises the soft limit as far as we're allowed to.
+ */
+static unsigned int part_max(void)
+{
+#if !defined(__DJGPP__) && !defined(__BEOS__) && !defined(__MINGW32__) && !defined (_MSC_VER)
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl))
+		return 0x10000;
+	if (rl.rlim_cur != RLIM_INFINITY && rl.rlim_cur < rl.rlim_max &&
+	    rl.rlim_cur < 0x10000 + PART_FD_SPARE) {
+		rl.rlim_cur = rl.rlim_max;
+		if (rl.rlim_cur > 0x10000 + PART_FD_SPARE)
+			rl.rlim_cur = 0x10000 + PART_FD_SPARE;
+		if (setrlimit(RLIMIT_NOFILE, &rl))
+			getrlimit(RLIMIT_NOFILE, &rl);
+	}
+	if (rl.rlim_cur == RLIM_INFINITY ||
+	    rl.rlim_cur >= 0x10000 + PART_FD_SPARE)
+		return 0x10000;
+	if (rl.rlim_cur <= PART_FD_SPARE)
+		return 1;
+	return rl.rlim_cur - PART_FD_SPARE;
+#else
+	/* The C runtime's default stdio stream limit */
+	return 512 - PART_FD_SPARE;
+#endif
+}
+
+/* Checked before we create anything */
+static void part_check(void)
+{
+	if (part_count > part_max())
+		exit(fprintf(stderr, "Error, -part=%u needs more open files "
+		             "than allowed, use at most -part=%u\n",
+		             part_count, part_max()));
+}
+
+/*
+ * atexit() handler.  Bucket files are of no use once we're gone, and neither
+ * is FILE.compact.PID unless we got as far as overwriting the pot with it.
+ */
+static void part_cleanup(void)
+{
+	unsigned int n;
+
+	if (part_base)
+	for (n = 0; n < part_count; n++) {
+		part_remove(part_base, 'b', n);
+		part_remove(part_base, 'x', n);
+		part_remove(part_base, 'r', n);
+	}
+
+	if (pot_temp) {
+		if (output)
+			fclose(output);
+		unlink(pot_temp);
+	}
+}
+
+static void part_run(char *base)
+{
+	int n;
+
+	part_base = base;
+	atexit(part_cleanup);
+
+	part_split(base);
+	if (verbose)
+		printf("Total lines read "LLu", deduping %u buckets\n",
+		       totLines, part_count);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+	for (n = 0; n < (int)part_count; n++)
+		part_dedup(base, n);
+
+	if (keep_order)
+		part_merge(base);
+
+	part_base = NULL;
+}
+
+/*
+ * -pot=FILE mode.  Same locking as log_file_flush() in logger.c, so john
+ * sessions simply wait while we rewrite the file.
+ */
+static void pot_lock(int fd, int lock)
+{
+#if FCNTL_LOCKS
+	struct flock fl;
+
+	memset(&fl, 0, sizeof(fl));
+	if (lock) {
+		fl.l_type = F_WRLCK;
+		while (fcntl(fd, F_SETLKW, &fl)) {
+			if (errno != EINTR)
+				pexit("fcntl(F_WRLCK)");
+		}
+	} else {
+		fl.l_type = F_UNLCK;
+		fcntl(fd, F_SETLK, &fl);
+	}
+#elif OS_FLOCK
+	while (flock(fd, lock ? LOCK_EX : LOCK_UN)) {
+		if (errno != EINTR)
+			pexit("flock");
+	}
+#endif
+}
+
+static void pot_run(void)
+{
+	char name[PATH_BUFFER_SIZE], buf[0x10000];
+	long long new_size;
+	size_t len;
+	int fd;
+
+#if defined (_MSC_VER) || defined(__MINGW32__)
+	fd = open(pot_name, O_RDWR | O_BINARY);
+#else
+	fd = open(pot_name, O_RDWR);
+#endif
+	if (fd < 0)
+		pexit("open: %s", pot_name);
+
+	pot_lock(fd, 1);
+	pot_size = (long long)lseek(fd, 0, SEEK_END);
+	pot_lock(fd, 0);
+
+	if (!part_count) {
+		part_count = pot_size / (vUNIQUE_BUFFER_SIZE / 2) + 1;
+		/* Bigger buckets rather than running out of descriptors */
+		if (part_count > part_max())
+			part_count = part_max();
+	}
+	part_check();
+	keep_order = 1;
+
+	if (!(fpInput = fopen(pot_name, "rb")))
+		pexit("fopen: %s", pot_name);
+/*
+ * Named after us so that whatever a crashed run left behind doesn't get in
+ * the way.  A file by this name can only be stale: remove it.
+ */
+	snprintf(name, sizeof(name), "%s.compact.%u", pot_name,
+	         (unsigned int)getpid());
+	unlink(name);
+	unique_init(name);
+	pot_temp = name;
+	part_run(name);
+
+/*
+ * Sessions may have appended to the pot meanwhile: take that as is, then
+ * overwrite the pot in place so their O_APPEND descriptors stay valid.  If
+ * we die half way, FILE.compact.PID still is a complete copy.
+ */
+	pot_lock(fd, 1);
+	if (jtr_fseek64(fpInput, pot_size, SEEK_SET) < 0) pexit("fseek");
+	if (fseek(output, 0, SEEK_END) < 0) pexit("fseek");
+	while ((len = fread(buf, 1, sizeof(buf), fpInput)))
+		if (fwrite(buf, len, 1, output) != 1)
+			pexit("fwrite");
+	if (ferror(fpInput)) pexit("fread");
+	if (fflush(output)) pexit("fflush");
+	new_size = jtr_ftell64(output);
+	pot_temp = NULL;
+
+	rewind(output);
+	if (lseek(fd, 0, SEEK_SET) < 0) pexit("lseek");
+	while ((len = fread(buf, 1, sizeof(buf), output)))
+		if (write_loop(fd, buf, len) < 0)
+			pexit("write");
+	if (ferror(output)) pexit("fread");
+	if (ftruncate(fd, new_size)) pexit("ftruncate");
+	pot_lock(fd, 0);
+
+	if (close(fd)) pexit("close");
+	fclose(fpInput);
+	unique_done();
+	unlink(name);
+}
+
 int unique(int argc, char **argv)
 {
-	while (argc > 2 && (!strcmp(argv[1], "-v") || !strncmp(argv[1], "-inp=", 5) || !strncmp(argv[1], "-cut=", 5) || !strncmp(argv[1], "-mem=", 5))) {
+	while ((argc > 2 && (!strcmp(argv[1], "-v") || !strncmp(argv[1], "-inp=", 5) || !strncmp(argv[1], "-cut=", 5) || !strncmp(argv[1], "-mem=", 5) || !strncmp(argv[1], "-part=", 6) || !strcmp(argv[1], "-keep-order"))) ||
+	       (argc > 1 && (!strncmp(argv[1], "-pot=", 5) || !strcmp(argv[1], "-sort")))) {
 		int i;
 		if (!strcmp(argv[1], "-v"))
 		{
@@ -399,6 +1071,36 @@ int unique(int argc, char **argv)
 			for (i = 1; i < argc; ++i)
 				argv[i] = argv[i+1];
 		}
+		else if (!strncmp(argv[1], "-part=", 6))
+		{
+			if (sscanf(argv[1], "-part=%u", &part_count) != 1 ||
+			    part_count < 1 || part_count > 0x10000)
+				exit(fprintf(stderr, "Error, invalid number in the -part= param\n"));
+			--argc;
+			for (i = 1; i < argc; ++i)
+				argv[i] = argv[i+1];
+		}
+		else if (!strncmp(argv[1], "-pot=", 5))
+		{
+			pot_name = &argv[1][5];
+			--argc;
+			for (i = 1; i < argc; ++i)
+				argv[i] = argv[i+1];
+		}
+		else if (!strcmp(argv[1], "-sort"))
+		{
+			pot_sort = 1;
+			--argc;
+			for (i = 1; i < argc; ++i)
+				argv[i] = argv[i+1];
+		}
+		else if (!strcmp(argv[1], "-keep-order"))
+		{
+			keep_order = 1;
+			--argc;
+			for (i = 1; i < argc; ++i)
+				argv[i] = argv[i+1];
+		}
 		else if (!strncmp(argv[1], "-mem=", 5))
 		{
 			int len;
@@ -442,11 +1144,19 @@ int unique(int argc, char **argv)
 		  exit(printf("Error, in this mode, we MUST have a file to test against\n"));
 		do_not_unique_against_self = 1;
 	}
-	if (argc != 2) {
+	if (pot_name && argc == 1 && !fpInput && !cut_len) {
+		pot_run();
+		printf("Total lines read "LLu" Unique lines written "LLu"\n",
+		       totLines, written_lines);
+		return 0;
+	}
+	if (argc != 2 || pot_name || pot_sort) {
 #if defined (__MINGW32__)
 	    puts("");
 #endif
-		printf("Usage: unique [-v] [-inp=fname] [-cut=len] [-mem=num] OUTPUT-FILE [-ex_file=FNAME2] [-ex_file_only=FNAME2]\n\n"
+		printf("Usage: unique [-v] [-inp=fname] [-cut=len] [-mem=num] [-part=num [-keep-order]]\n"
+			 "       OUTPUT-FILE [-ex_file=FNAME2] [-ex_file_only=FNAME2]\n"
+			 "       unique [-v] [-mem=num] [-part=num] [-sort] -pot=POT-FILE\n\n"
 			 "       reads from stdin 'normally', but can be overridden by optional -inp=\n"
 			 "       If -ex_file=XX is used, then data from file XX is also used to\n"
 			 "       unique the data, but nothing is ever written to XX. Thus, any data in\n"
@@ -458,6 +1168,14 @@ int unique(int argc, char **argv)
 			 "       params.h.  The default is %u.  Valid range is from 13 to 25 (memory usage\n"
 			 "       doubles each number).  If you go TOO large, unique will swap and thrash and\n"
 			 "       work VERY slow\n"
+			 "       -part=num  Split the input into num temporary buckets next to\n"
+			 "       OUTPUT-FILE and dedup those in parallel.  For inputs much larger\n"
+			 "       than memory; each bucket (input size / num) must fit in memory.\n"
+			 "       Output is grouped by bucket unless -keep-order is also given,\n"
+			 "       then lines are output in order of first occurrence\n"
+			 "       -pot=FILE  Compact a .pot file in place, dropping duplicate\n"
+			 "       cracks.  Safe to use while john is running.  -sort groups\n"
+			 "       the lines by format\n"
 			 "\n"
 			 "       -v is for 'verbose' mode, outputs line counts during the run\n",
 			UNIQUE_HASH_LOG);
@@ -470,8 +1188,17 @@ int unique(int argc, char **argv)
 
 	if (!fpInput)
 		fpInput = stdin;
+	if (keep_order && !part_count)
+		exit(fprintf(stderr, "Error, -keep-order needs -part=\n"));
+	if (part_count && do_not_unique_against_self)
+		exit(fprintf(stderr, "Error, -ex_file_only can't be used with -part=\n"));
+	if (part_count)
+		part_check();
 	unique_init(argv[1]);
-	unique_run();
+	if (part_count)
+		part_run(argv[1]);
+	else
+		unique_run();
 	unique_done();
     printf ("Total lines read "LLu" Unique lines written "LLu"\n", totLines, written_lines);
 
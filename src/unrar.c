@@ -1188,10 +1188,18 @@ Bailout:
 	//rar_dbgmsg("Written size: %ld\n", (long)unpack_data->written_size);
 	//rar_dbgmsg("True size: %ld\n", (long)unpack_data->true_size);
 
-	/* Free resources */
-	ppm_destructor(&unpack_data->ppm_data);
-	rarvm_free(&unpack_data->rarvm_data);
+	/* Free resources. The VM memory and PPM heap are kept for the
+	   next call, see rar_unpack_free() */
+	ppm_release(&unpack_data->ppm_data);
 	rar_init_filters(unpack_data);
 
 	return retval;
 }
+
+/* Release what rar_unpack29() keeps between calls */
+void rar_unpack_free(unpack_data_t *unpack_data)
+{
+	ppm_destructor(&unpack_data->ppm_data);
+	rarvm_free(&unpack_data->rarvm_data);
+	rar_init_filters(unpack_data);
+}
@@ -237,5 +237,6 @@ void rar_unp_write_buf_old(unpack_data_t *unpack_data);
 int rar_decode_number(unpack_data_t *unpack_data, struct Decode *decode);
 void rar_init_filters(unpack_data_t *unpack_data);
 int rar_unpack29(const unsigned char *fd, int solid, unpack_data_t *unpack_data);
+void rar_unpack_free(unpack_data_t *unpack_data);
 
 #endif
@@ -96,12 +96,21 @@ static long sub_allocator_get_allocated_memory(sub_allocator_t *sub_alloc)
 	return sub_alloc->sub_allocator_size;
 }
 
+/*
+ * The heap itself is kept for the next start, a cracker runs the
+ * decoder over and over with the same (or similar) model sizes and
+ * we don't want a malloc/free of up to 128 MB per candidate.
+ */
 static void sub_allocator_stop_sub_allocator(sub_allocator_t *sub_alloc)
 {
-	if (sub_alloc->sub_allocator_size) {
-		sub_alloc->sub_allocator_size = 0;
-		MEM_FREE(sub_alloc->heap_start);
-	}
+	sub_alloc->sub_allocator_size = 0;
+}
+
+static void sub_allocator_free(sub_allocator_t *sub_alloc)
+{
+	sub_alloc->sub_allocator_size = 0;
+	sub_alloc->heap_alloc_size = 0;
+	MEM_FREE(sub_alloc->heap_start);
 }
 
 static int sub_allocator_start_sub_allocator(sub_allocator_t *sub_alloc, int sa_size)
@@ -122,9 +131,13 @@ static int sub_allocator_start_sub_allocator(sub_allocator_t *sub_alloc, int sa_
 	/* Allow for aligned access requirements */
 	alloc_size += UNIT_SIZE;
 #endif
-	if ((sub_alloc->heap_start = (unsigned char *) rar_malloc(alloc_size)) == NULL) {
-		//rar_dbgmsg("sub_alloc start failed\n");
-		return 0;
+	if (alloc_size > sub_alloc->heap_alloc_size) {
+		sub_allocator_free(sub_alloc);
+		if ((sub_alloc->heap_start = (unsigned char *) rar_malloc(alloc_size)) == NULL) {
+			//rar_dbgmsg("sub_alloc start failed\n");
+			return 0;
+		}
+		sub_alloc->heap_alloc_size = alloc_size;
 	}
 	sub_alloc->heap_end = sub_alloc->heap_start + alloc_size - UNIT_SIZE;
 	sub_alloc->sub_allocator_size = t;
@@ -933,6 +946,12 @@ void ppm_constructor(ppm_data_t *ppm_data)
 }
 
 void ppm_destructor(ppm_data_t *ppm_data)
+{
+	sub_allocator_free(&ppm_data->sub_alloc);
+}
+
+/* Like ppm_destructor() but keeps the heap around for the next file */
+void ppm_release(ppm_data_t *ppm_data)
 {
 	sub_allocator_stop_sub_allocator(&ppm_data->sub_alloc);
 }
@@ -46,6 +46,7 @@ typedef struct sub_allocator_tag
 	unsigned char *ptext, *units_start, *heap_end, *fake_units_start;
 	unsigned char *heap_start, *lo_unit, *hi_unit;
 	long sub_allocator_size;
+	unsigned int heap_alloc_size;	/* kept across files, see ppm_release() */
 	struct rar_node free_list[N_INDEXES];
 	short indx2units[N_INDEXES], units2indx[128], glue_count;
 } sub_allocator_t;
@@ -115,5 +116,6 @@ int ppm_decode_init(ppm_data_t *ppm_data, const unsigned char **fd, struct unpac
 int ppm_decode_char(ppm_data_t *ppm_data, const unsigned char **fd, struct unpack_data_tag *unpack_data);
 void ppm_constructor(ppm_data_t *ppm_data);
 void ppm_destructor(ppm_data_t *ppm_data);
+void ppm_release(ppm_data_t *ppm_data);
 
 #endif
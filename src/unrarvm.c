@@ -195,6 +195,8 @@ unsigned int rar_crc(unsigned int start_crc, void *addr, unsigned int size)
 
 int rarvm_init(rarvm_data_t *rarvm_data)
 {
+	if (rarvm_data->mem)
+		return 1;
 	rarvm_data->mem = (unsigned char *) rar_malloc(RARVM_MEMSIZE+4);
 	if (!rarvm_data->mem) {
 		return 0;
@@ -1,6 +1,6 @@
 /*
  * The source for this file AUTO-GENERATED on:
- * Tue, Feb  9, 2016  8:27:33 PM
+ * Mon Oct 19 11:24:47 UTC 2026
  *
  * NOTE.  This file IS 100% auto-generated code.
  *
@@ -26,10 +26,10 @@
 
 /*****************************************************************************
  * This software was written by Jim Fougeron jfoug AT cox dot net
- * in 2013-2115. No copyright is claimed, and the software is hereby
+ * in 2013-2016. No copyright is claimed, and the software is hereby
  * placed in the public domain. In case this attempt to disclaim
  * copyright and place the software in the public domain is deemed
- * null and void, then the software is Copyright (c) 2013-2015 Jim Fougeron
+ * null and void, then the software is Copyright (c) 2013-2016 Jim Fougeron
  * and it is hereby released to the general public under the following
  * terms:
  *
@@ -64,7 +64,7 @@
 
 #include "arch.h"
 
-#if !FAST_FORMATS_OMP
+#if !FAST_FORMATS_OMP && DYNAMIC_DISABLE_OMP
 #ifdef _OPENMP
 #  define FORCE_THREAD_MD5_body
 #endif
@@ -645,6 +645,7 @@ static void DoMD5_crypt_sse(void *in, uint32_t ilen[MD5_LOOPS], void *out[MD5_LO
 	union yy { unsigned char u[16]; ARCH_WORD_32 a[16/sizeof(ARCH_WORD_32)]; } y;
 	uint32_t i, j, loops[MD5_LOOPS], bMore, cnt;
 	unsigned char *cp = (unsigned char*)in;
+	int bHex = (eLargeOut_get(tid) == eBase16);
 	for (i = 0; i < MD5_LOOPS; ++i) {
 		loops[i] = Do_FixBufferLen32(cp, ilen[i], 0);
 		cp += 64*4;
@@ -659,7 +660,13 @@ static void DoMD5_crypt_sse(void *in, uint32_t ilen[MD5_LOOPS], void *out[MD5_LO
 				for (j = 0; j < 16/sizeof(ARCH_WORD_32); ++j) {
 					y.a[j] =  a[(j*SIMD_COEF_32)+offx];
 				}
-				*(tot_len+i) += large_hash_output(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 16, tid);
+				// same as DoMD5_crypt: base-16 is the usual case, so skip the
+				// large_hash_output switch for each lane of each block.
+				if (bHex) {
+					hex_out_buf(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 16);
+					*(tot_len+i) += 16*2;
+				} else
+					*(tot_len+i) += large_hash_output(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 16, tid);
 			} else if (cnt < loops[i]) bMore = 1;
 		}
 		cp += 32*2; ++cnt;
@@ -1157,6 +1164,7 @@ static void DoMD4_crypt_sse(void *in, uint32_t ilen[MD4_LOOPS], void *out[MD4_LO
 	union yy { unsigned char u[16]; ARCH_WORD_32 a[16/sizeof(ARCH_WORD_32)]; } y;
 	uint32_t i, j, loops[MD4_LOOPS], bMore, cnt;
 	unsigned char *cp = (unsigned char*)in;
+	int bHex = (eLargeOut_get(tid) == eBase16);
 	for (i = 0; i < MD4_LOOPS; ++i) {
 		loops[i] = Do_FixBufferLen32(cp, ilen[i], 0);
 		cp += 64*4;
@@ -1171,7 +1179,13 @@ static void DoMD4_crypt_sse(void *in, uint32_t ilen[MD4_LOOPS], void *out[MD4_LO
 				for (j = 0; j < 16/sizeof(ARCH_WORD_32); ++j) {
 					y.a[j] =  a[(j*SIMD_COEF_32)+offx];
 				}
-				*(tot_len+i) += large_hash_output(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 16, tid);
+				// same as DoMD4_crypt: base-16 is the usual case, so skip the
+				// large_hash_output switch for each lane of each block.
+				if (bHex) {
+					hex_out_buf(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 16);
+					*(tot_len+i) += 16*2;
+				} else
+					*(tot_len+i) += large_hash_output(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 16, tid);
 			} else if (cnt < loops[i]) bMore = 1;
 		}
 		cp += 32*2; ++cnt;
@@ -1667,6 +1681,7 @@ static void DoSHA1_crypt_sse(void *in, uint32_t ilen[SHA1_LOOPS], void *out[SHA1
 	union yy { unsigned char u[20]; ARCH_WORD_32 a[20/sizeof(ARCH_WORD_32)]; } y;
 	uint32_t i, j, loops[SHA1_LOOPS], bMore, cnt;
 	unsigned char *cp = (unsigned char*)in;
+	int bHex = (eLargeOut_get(tid) == eBase16);
 	for (i = 0; i < SHA1_LOOPS; ++i) {
 		loops[i] = Do_FixBufferLen32(cp, ilen[i], 1);
 		cp += 64*4;
@@ -1681,7 +1696,13 @@ static void DoSHA1_crypt_sse(void *in, uint32_t ilen[SHA1_LOOPS], void *out[SHA1
 				for (j = 0; j < 20/sizeof(ARCH_WORD_32); ++j) {
 					y.a[j] = JOHNSWAP(a[(j*SIMD_COEF_32)+offx]);
 				}
-				*(tot_len+i) += large_hash_output(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 20, tid);
+				// same as DoSHA1_crypt: base-16 is the usual case, so skip the
+				// large_hash_output switch for each lane of each block.
+				if (bHex) {
+					hex_out_buf(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 20);
+					*(tot_len+i) += 20*2;
+				} else
+					*(tot_len+i) += large_hash_output(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 20, tid);
 			} else if (cnt < loops[i]) bMore = 1;
 		}
 		cp += 32*2; ++cnt;
@@ -2179,6 +2200,7 @@ static void DoSHA224_crypt_sse(void *in, uint32_t ilen[SHA224_LOOPS], void *out[
 	union yy { unsigned char u[32]; ARCH_WORD_32 a[32/sizeof(ARCH_WORD_32)]; } y;
 	uint32_t i, j, loops[SHA224_LOOPS], bMore, cnt;
 	unsigned char *cp = (unsigned char*)in;
+	int bHex = (eLargeOut_get(tid) == eBase16);
 	for (i = 0; i < SHA224_LOOPS; ++i) {
 		loops[i] = Do_FixBufferLen32(cp, ilen[i], 1);
 		cp += 64*4;
@@ -2193,7 +2215,13 @@ static void DoSHA224_crypt_sse(void *in, uint32_t ilen[SHA224_LOOPS], void *out[
 				for (j = 0; j < 32/sizeof(ARCH_WORD_32); ++j) {
 					y.a[j] = JOHNSWAP(a[(j*SIMD_COEF_32)+offx]);
 				}
-				*(tot_len+i) += large_hash_output(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 28, tid);
+				// same as DoSHA224_crypt: base-16 is the usual case, so skip the
+				// large_hash_output switch for each lane of each block.
+				if (bHex) {
+					hex_out_buf(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 28);
+					*(tot_len+i) += 28*2;
+				} else
+					*(tot_len+i) += large_hash_output(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 28, tid);
 			} else if (cnt < loops[i]) bMore = 1;
 		}
 		cp += 32*2; ++cnt;
@@ -2691,6 +2719,7 @@ static void DoSHA256_crypt_sse(void *in, uint32_t ilen[SHA256_LOOPS], void *out[
 	union yy { unsigned char u[32]; ARCH_WORD_32 a[32/sizeof(ARCH_WORD_32)]; } y;
 	uint32_t i, j, loops[SHA256_LOOPS], bMore, cnt;
 	unsigned char *cp = (unsigned char*)in;
+	int bHex = (eLargeOut_get(tid) == eBase16);
 	for (i = 0; i < SHA256_LOOPS; ++i) {
 		loops[i] = Do_FixBufferLen32(cp, ilen[i], 1);
 		cp += 64*4;
@@ -2705,7 +2734,13 @@ static void DoSHA256_crypt_sse(void *in, uint32_t ilen[SHA256_LOOPS], void *out[
 				for (j = 0; j < 32/sizeof(ARCH_WORD_32); ++j) {
 					y.a[j] = JOHNSWAP(a[(j*SIMD_COEF_32)+offx]);
 				}
-				*(tot_len+i) += large_hash_output(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 32, tid);
+				// same as DoSHA256_crypt: base-16 is the usual case, so skip the
+				// large_hash_output switch for each lane of each block.
+				if (bHex) {
+					hex_out_buf(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 32);
+					*(tot_len+i) += 32*2;
+				} else
+					*(tot_len+i) += large_hash_output(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 32, tid);
 			} else if (cnt < loops[i]) bMore = 1;
 		}
 		cp += 32*2; ++cnt;
@@ -3203,6 +3238,7 @@ static void DoSHA384_crypt_sse(void *in, uint32_t ilen[SHA384_LOOPS], void *out[
 	union yy { unsigned char u[64]; ARCH_WORD_64 a[64/sizeof(ARCH_WORD_64)]; } y;
 	uint32_t i, j, loops[SHA384_LOOPS], bMore, cnt;
 	unsigned char *cp = (unsigned char*)in;
+	int bHex = (eLargeOut_get(tid) == eBase16);
 	for (i = 0; i < SHA384_LOOPS; ++i) {
 		loops[i] = Do_FixBufferLen64(cp, ilen[i], 1);
 		cp += 64*4;
@@ -3217,7 +3253,13 @@ static void DoSHA384_crypt_sse(void *in, uint32_t ilen[SHA384_LOOPS], void *out[
 				for (j = 0; j < 64/sizeof(ARCH_WORD_64); ++j) {
 					y.a[j] = JOHNSWAP64(a[(j*SIMD_COEF_64)+offx]);
 				}
-				*(tot_len+i) += large_hash_output(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 48, tid);
+				// same as DoSHA384_crypt: base-16 is the usual case, so skip the
+				// large_hash_output switch for each lane of each block.
+				if (bHex) {
+					hex_out_buf(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 48);
+					*(tot_len+i) += 48*2;
+				} else
+					*(tot_len+i) += large_hash_output(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 48, tid);
 			} else if (cnt < loops[i]) bMore = 1;
 		}
 		cp += 64*2; ++cnt;
@@ -3715,6 +3757,7 @@ static void DoSHA512_crypt_sse(void *in, uint32_t ilen[SHA512_LOOPS], void *out[
 	union yy { unsigned char u[64]; ARCH_WORD_64 a[64/sizeof(ARCH_WORD_64)]; } y;
 	uint32_t i, j, loops[SHA512_LOOPS], bMore, cnt;
 	unsigned char *cp = (unsigned char*)in;
+	int bHex = (eLargeOut_get(tid) == eBase16);
 	for (i = 0; i < SHA512_LOOPS; ++i) {
 		loops[i] = Do_FixBufferLen64(cp, ilen[i], 1);
 		cp += 64*4;
@@ -3729,7 +3772,13 @@ static void DoSHA512_crypt_sse(void *in, uint32_t ilen[SHA512_LOOPS], void *out[
 				for (j = 0; j < 64/sizeof(ARCH_WORD_64); ++j) {
 					y.a[j] = JOHNSWAP64(a[(j*SIMD_COEF_64)+offx]);
 				}
-				*(tot_len+i) += large_hash_output(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 64, tid);
+				// same as DoSHA512_crypt: base-16 is the usual case, so skip the
+				// large_hash_output switch for each lane of each block.
+				if (bHex) {
+					hex_out_buf(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 64);
+					*(tot_len+i) += 64*2;
+				} else
+					*(tot_len+i) += large_hash_output(y.u, &(((unsigned char*)out[i])[*(tot_len+i)]), 64, tid);
 			} else if (cnt < loops[i]) bMore = 1;
 		}
 		cp += 64*2; ++cnt;
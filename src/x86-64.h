@@ -169,6 +169,18 @@
 #define DES_BS_VECTOR_SIZE		8
 #define DES_BS_VECTOR			5
 #define DES_BS_ALGORITHM_NAME		"DES 256/256 AVX-16 + 64/64"
+#elif __AVX512F__ || JOHN_AVX512F
+/* 512-bit as 1x512, with vpternlog for the selects in sboxes-s.c */
+#define DES_BS_VECTOR			8
+#undef DES_BS
+#define DES_BS				3
+#undef CPU_NAME
+#if __AVX512BW__ || JOHN_AVX512BW
+#define CPU_NAME			"AVX512BW"
+#else
+#define CPU_NAME			"AVX512F"
+#endif
+#define DES_BS_ALGORITHM_NAME		"DES 512/512 AVX512F"
 #elif __AVX2__ || JOHN_AVX2
 /* 256-bit as 1x256 */
 #define DES_BS_VECTOR			4
@@ -233,7 +245,7 @@
 #endif
 #define DES_BS_EXPAND			1
 
-#if CPU_DETECT && DES_BS == 3
+#if CPU_DETECT && DES_BS == 3 && defined(JOHN_XOP)
 #define CPU_REQ_XOP			1
 #undef CPU_NAME
 #define CPU_NAME			"XOP"
@@ -400,4 +412,19 @@
 #endif
 #endif
 
+/*
+ * With AVX2 or AVX-512, OpenMP builds may also run one Blowfish instance per
+ * 32-bit vector lane, with the S-box lookups done as gathers.  Whether that
+ * beats the scalar interleaving above depends on the gather throughput of the
+ * particular CPU, so BF_std.c times both at runtime and keeps the faster one.
+ * Define BF_SIMD as 0 to build without it.
+ */
+#ifndef BF_SIMD
+#if __AVX512F__ || __AVX2__
+#define BF_SIMD				SIMD_COEF_32
+#else
+#define BF_SIMD				0
+#endif
+#endif
+
 #endif
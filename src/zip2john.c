@@ -108,6 +108,7 @@
 #include "formats.h"
 #include "stdint.h"
 #include "pkzip.h"
+#include "filepool.h"
 #ifdef _MSC_VER
 #include "missing_getopt.h"
 #endif
@@ -117,12 +118,39 @@
 
 static int checksum_only=0, use_magic=0;
 static int force_2_byte_checksum = 0;
+static uint32_t max_inline;
 static char *ascii_fname, *only_fname;
 
 static char *MagicTypes[]= { "", "DOC", "XLS", "DOT", "XLT", "EXE", "DLL", "ZIP", "BMP", "DIB", "GIF", "PDF", "GZ", "TGZ", "BZ2", "TZ2", "FLV", "SWF", "MP3", NULL };
 static int  MagicToEnum[] = {0,  1,    1,     1,     1,     2,     2,     3,     4,     4,     5,     6,     7,    7,     8,     8,     9,     10,    11,  0};
 
 static void process_old_zip(const char *fname);
+
+/*
+ * Copies len bytes at pos in fp to stdout as hex, a chunk at a time, so that
+ * large blobs never need to be held in memory.  Bytes past the end of the
+ * file come out as "ff", as when we used to fgetc() them one by one.
+ */
+static void print_hex(FILE *fp, long pos, uint32_t len)
+{
+	unsigned char buf[LARGE_ENOUGH];
+	char hex[2 * LARGE_ENOUGH];
+
+	fseek(fp, pos, SEEK_SET);
+	while (len) {
+		size_t i, count = len < sizeof(buf) ? len : sizeof(buf);
+		size_t got = fread(buf, 1, count, fp);
+
+		memset(buf + got, 0xff, count - got);
+		for (i = 0; i < count; i++) {
+			hex[2 * i] = itoa16[ARCH_INDEX(buf[i] >> 4)];
+			hex[2 * i + 1] = itoa16[ARCH_INDEX(buf[i] & 0x0f)];
+		}
+		fwrite(hex, 1, 2 * count, stdout);
+		len -= count;
+	}
+}
+
 static void process_file(const char *fname)
 {
 	unsigned char filename[1024];
@@ -130,7 +158,10 @@ static void process_file(const char *fname)
 	int i;
 	char path[LARGE_ENOUGH];
 	char *cur=0, *cp;
+	char *best_bname = NULL;
 	uint32_t best_len = 0xffffffff;
+	long best_hdr = 0, best_data = 0;
+	uint32_t best_data_len = 0;
 
 
 	if (!(fp = fopen(fname, "rb"))) {
@@ -139,6 +170,7 @@ static void process_file(const char *fname)
 	}
 
 	while (!feof(fp)) {
+		long hdr_pos = ftell(fp);
 		uint32_t id = fget32LE(fp);
 		uint32_t store = 0;
 
@@ -192,8 +224,8 @@ static void process_file(const char *fname)
 				} else {
 					store = 1;
 					best_len = compressed_size;
-					if (cur) MEM_FREE(cur);
-					cur = mem_alloc(compressed_size*2 + 400);
+					if (!cur)
+						cur = mem_alloc(400);
 					cp = cur;
 				}
 
@@ -233,27 +265,16 @@ static void process_file(const char *fname)
 				real_cmpr_len = compressed_size-2-(4+4*efh_aes_strength)-extrafield_length;
 				// not quite sure why the real_cmpr_len is 'off by 1' ????
 				++real_cmpr_len;
-				if (store) cp += sprintf(cp, "*%x*", real_cmpr_len);
-
-				for (i = 0; i < real_cmpr_len; i++) {
-					d = fgetc(fp);
-					if (store)
-						cp += sprintf(cp, "%c%c",
-						              itoa16[ARCH_INDEX(d >> 4)],
-						              itoa16[ARCH_INDEX(d & 0x0f)]);
+				if (store) {
+					cp += sprintf(cp, "*%x*", real_cmpr_len);
+					/* The data and authentication code are
+					   only read once we know which is best */
+					best_bname = bname;
+					best_hdr = hdr_pos;
+					best_data = ftell(fp);
+					best_data_len = real_cmpr_len;
 				}
-				if (store) cp += sprintf(cp, "*");
-				for (i = 0; i < 10; i++) {
-					d = fgetc(fp);
-					if (store) cp += sprintf(cp, "%c%c",
-					    itoa16[ARCH_INDEX(d >> 4)],
-					    itoa16[ARCH_INDEX(d & 0x0f)]);
-				}
-				for (d = ' '+1; d < '~'; ++d) {
-					if (!strchr(fname, d) && d != ':' && !isxdigit(d))
-						break;
-				}
-				if (store) cp += sprintf(cp, "*$/zip2$:::::%s\n", bname);
+				fseek(fp, real_cmpr_len + 10, SEEK_CUR);
 			} else if (flags & 1) {	/* old encryption */
 				fclose(fp);
 				fp = 0;
@@ -273,8 +294,17 @@ static void process_file(const char *fname)
 	}
 
 cleanup:
-	if (cur)
-		printf ("%s\n",cur);
+	if (cur) {
+		fputs(cur, stdout);
+		if (max_inline && best_data_len > max_inline)
+			printf("ZFILE*%s*%lx*%lx", fname, best_hdr, best_data);
+		else
+			print_hex(fp, best_data, best_data_len);
+		printf("*");
+		print_hex(fp, best_data + best_data_len, 10);
+		printf("*$/zip2$:::::%s\n\n", best_bname);
+		MEM_FREE(cur);
+	}
 	fclose(fp);
 }
 
@@ -288,7 +318,7 @@ typedef struct _zip_ptr
 	uint32_t      offset, offex, crc, cmp_len, decomp_len;
 	char          chksum[5];
 	char          chksum2[5];
-	char         *hash_data;
+	long          data_pos;
 } zip_ptr;
 typedef struct _zip_file
 {
@@ -315,19 +345,6 @@ static int magic_type(const char *filename) {
 			return MagicToEnum[i];
 	return 0;
 }
-static char *toHex(unsigned char *p, int len) {
-	static char *Buf;
-	static size_t BufSz = 4096;
-	char *cp;
-	int i;
-
-	BufSz = MAX(BufSz, 2 * len + 1);
-	Buf = realloc(Buf, BufSz);
-	cp = Buf;
-	for (i = 0; i < len; ++i)
-		cp += sprintf(cp, "%02x", p[i]);
-	return Buf;
-}
 static int LoadZipBlob(FILE *fp, zip_ptr *p, zip_file *zfp, const char *zip_fname)
 {
 	uint16_t version,flags,lastmod_time,lastmod_date,filename_length,extrafield_length;
@@ -402,8 +419,11 @@ static int LoadZipBlob(FILE *fp, zip_ptr *p, zip_file *zfp, const char *zip_fnam
 			"%s->%s PKZIP Encr:%s%s cmplen=%d, decmplen=%d, crc=%X\n",
 			jtr_basename(zip_fname), filename, zfp->check_bytes==2?" 2b chk,":"", zfp->check_in_crc?"":" TS_chk,", p->cmp_len, p->decomp_len, p->crc);
 
-		p->hash_data = mem_alloc_tiny(p->cmp_len+1, MEM_ALIGN_WORD);
-		if (fread(p->hash_data, 1, p->cmp_len, fp) != p->cmp_len) {
+		/* The data is only read (and hex encoded straight to stdout)
+		   for the entries we end up using */
+		p->data_pos = ftell(fp);
+		if (p->cmp_len &&
+		    (fseek(fp, p->cmp_len - 1, SEEK_CUR) || fgetc(fp) == EOF)) {
 			fprintf(stderr, "Error, fread could not read the data from the file:  %s\n", zip_fname);
 			return 0;
 		}
@@ -539,12 +559,23 @@ print_and_cleanup:;
 				len = 12+180;
 			if (len > hashes[i].cmp_len)
 				len = hashes[i].cmp_len; // even though we 'could' output a '2', we do not.  We only need one full inflate CRC check file.
-			printf("1*%x*%x*%x*%s*%s*%s*", hashes[i].magic_type, hashes[i].cmptype, len, hashes[i].chksum, hashes[i].chksum2, toHex((unsigned char*)hashes[i].hash_data, len));
+			printf("1*%x*%x*%x*%s*%s*", hashes[i].magic_type, hashes[i].cmptype, len, hashes[i].chksum, hashes[i].chksum2);
+			print_hex(fp, hashes[i].data_pos, len);
+			printf("*");
 		}
 		// Ok, now output the 'little' one (the first).
 		if (!checksum_only) {
-			printf("%x*%x*%x*%x*%x*%x*%x*%x*", 2, hashes[0].magic_type, hashes[0].cmp_len, hashes[0].decomp_len, hashes[0].crc, hashes[0].offset, hashes[0].offex, hashes[0].cmptype);
-			printf("%x*%s*%s*%s*", hashes[0].cmp_len, hashes[0].chksum, hashes[0].chksum2, toHex((unsigned char*)hashes[0].hash_data, hashes[0].cmp_len));
+			// Too large to inline, have john read it from the .zip
+			int from_file = max_inline && hashes[0].cmp_len > max_inline;
+
+			printf("%x*%x*%x*%x*%x*%x*%x*%x*", from_file ? 3 : 2, hashes[0].magic_type, hashes[0].cmp_len, hashes[0].decomp_len, hashes[0].crc, hashes[0].offset, hashes[0].offex, hashes[0].cmptype);
+			if (from_file)
+				printf("%x*%s*%s*%s*", (unsigned int)strlen(fname), hashes[0].chksum, hashes[0].chksum2, fname);
+			else {
+				printf("%x*%s*%s*", hashes[0].cmp_len, hashes[0].chksum, hashes[0].chksum2);
+				print_hex(fp, hashes[0].data_pos, hashes[0].cmp_len);
+				printf("*");
+			}
 		}
 		printf("$/pkzip2$:::::%s\n", fname);
 	}
@@ -567,16 +598,20 @@ static int usage(char *name) {
 	fprintf(stderr, " -m Use \"file magic\" as known-plain if applicable. This is slightly faster\n");
 	fprintf(stderr, "    but not 100%% safe in all situations.\n");
 	fprintf(stderr, " -2 Force 2 byte checksum computation\n");
+	fprintf(stderr, "Other options:\n");
+	fprintf(stderr, " -j N  Process N .zip files at a time (output order is kept)\n");
+	fprintf(stderr, " -s SIZE  Don't inline encrypted data larger than SIZE bytes, refer to\n");
+	fprintf(stderr, "    the .zip file instead (which then has to be kept in place)\n");
 
 	return EXIT_FAILURE;
 }
 
 int zip2john(int argc, char **argv)
 {
-	int c;
+	int c, jobs = 1;
 
 	/* Parse command line */
-	while ((c = getopt(argc, argv, "a:o:cn2")) != -1) {
+	while ((c = getopt(argc, argv, "a:o:cn2j:s:")) != -1) {
 		switch (c) {
 		case 'a':
 			ascii_fname = optarg;
@@ -598,6 +633,12 @@ int zip2john(int argc, char **argv)
 			force_2_byte_checksum = 1;
 			fprintf(stderr, "Forcing a 2 byte checksum detection\n");
 			break;
+		case 'j':
+			jobs = filepool_jobs(optarg);
+			break;
+		case 's':
+			max_inline = atoi(optarg);
+			break;
 		case '?':
 		default:
 			return usage(argv[0]);
@@ -608,8 +649,7 @@ int zip2john(int argc, char **argv)
 		return usage(argv[0]);
 	argv += optind;
 
-	while(argc--)
-		process_file(*argv++);
+	filepool_run(argc, argv, jobs, process_file);
 
 	cleanup_tiny_memory();
 	MEMDBG_PROGRAM_EXIT_CHECKS(stderr);